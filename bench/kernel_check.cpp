@@ -0,0 +1,125 @@
+#include <vector>
+#include <random>
+#include <stdio.h>
+#include <math.h>
+#include "../common/movement.h"
+#include "../server/hit_kernel.h"
+
+// --- Hit kernel check ---
+//
+// capsule_hits() has three builds (AVX, SSE2, scalar) and only one of them is in any given binary, so the
+// Makefile builds this check twice: once with the default flags and once with -mavx. Each run holds the
+// vector path it was built with to capsule_hits_scalar() on random shapes and batches, including batch
+// sizes that leave a scalar tail, and checks that every hit lies inside swept_capsule_bounds(). Then it
+// pins down the one shape with no short way round: a swing of exactly half a turn.
+
+static int failures = 0;
+
+static void expect(bool ok, const char* what, int round) {
+    if (ok) return;
+    failures++;
+    printf("FAIL: %s (round %d)\n", what, round);
+}
+
+static const char* vector_path() {
+#if defined(__AVX__)
+    return "AVX";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+// Runs both paths over one batch; true when they report the same hits in the same order.
+static bool same_hits(const SweptCapsule& shape, const std::vector<float>& xs, const std::vector<float>& ys,
+                      std::vector<uint16_t>& hits) {
+    int count = (int)xs.size();
+    std::vector<uint16_t> expected(count + 1);
+    hits.assign(count + 1, 0);
+    int found = capsule_hits(shape, xs.data(), ys.data(), count, hits.data());
+    int wanted = capsule_hits_scalar(shape, xs.data(), ys.data(), count, expected.data());
+    hits.resize(found);
+    expected.resize(wanted);
+    return hits == expected;
+}
+
+static bool in_bounds(const SweptCapsule& shape, float x, float y) {
+    float min_x, min_y, max_x, max_y;
+    swept_capsule_bounds(shape, min_x, min_y, max_x, max_y);
+    return x >= min_x && x <= max_x && y >= min_y && y <= max_y;
+}
+
+static void check_random_batches(std::mt19937& rng, int rounds) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> xs, ys;
+    std::vector<uint16_t> hits;
+    for (int round = 0; round < rounds; round++) {
+        float inner = 20.0f + unit(rng) * 40.0f;
+        float outer = inner + 20.0f + unit(rng) * 300.0f;
+        float from = unit(rng) * 12.0f - 6.0f; // Past +-pi too, as rotations arrive unwrapped
+        float to = from + (unit(rng) * 2.0f - 1.0f) * 3.2f;
+        if (round % 7 == 0) to = from + (round % 14 == 0 ? 1.0f : -1.0f) * 3.14159265f; // Half turns
+        bool swept = round % 5 != 0;
+        SweptCapsule shape = make_swept_capsule(1000.0f, 1000.0f, from, to, swept, inner, outer, PLAYER_RADIUS);
+
+        int count = round % 67; // Every remainder mod 4 and 8, including empty batches
+        float spread = outer + 2.0f * PLAYER_RADIUS;
+        xs.resize(count);
+        ys.resize(count);
+        for (int k = 0; k < count; k++) {
+            xs[k] = shape.px + (unit(rng) * 2.0f - 1.0f) * spread;
+            ys[k] = shape.py + (unit(rng) * 2.0f - 1.0f) * spread;
+        }
+        expect(same_hits(shape, xs, ys, hits), "capsule_hits() disagrees with capsule_hits_scalar()", round);
+        for (size_t k = 0; k < hits.size(); k++) {
+            expect(in_bounds(shape, xs[hits[k]], ys[hits[k]]), "hit outside swept_capsule_bounds()", round);
+        }
+    }
+}
+
+// A swing of exactly half a turn covers the half-plane counter-clockwise of `from`, and nothing behind it.
+static void check_half_turns() {
+    const float inner = 30.0f, outer = 200.0f, mid = 115.0f;
+    std::vector<float> xs(9), ys(9);
+    std::vector<uint16_t> hits;
+    for (int round = 0; round < 16; round++) {
+        float from = -3.14159265f + round * 0.4f;
+        float to = from + 3.14159265f;
+        SweptCapsule shape = make_swept_capsule(500.0f, 500.0f, from, to, true, inner, outer, PLAYER_RADIUS);
+        // Quarter turn counter-clockwise of `from`, at mid reach: the middle of the swing
+        float cx = -sinf(from), cy = cosf(from);
+        // Fill a batch wider than one vector so the target goes through the vector loop, not the tail
+        for (int k = 0; k < 9; k++) {
+            xs[k] = shape.px - cx * mid; // Behind the swing
+            ys[k] = shape.py - cy * mid;
+        }
+        xs[3] = shape.px + cx * mid;
+        ys[3] = shape.py + cy * mid;
+        expect(same_hits(shape, xs, ys, hits), "half turn: capsule_hits() disagrees with capsule_hits_scalar()", round);
+        expect(hits.size() == 1 && hits[0] == 3, "half turn: the middle of the swing isn't hit (or its mirror is)", round);
+        expect(in_bounds(shape, xs[3], ys[3]), "half turn: middle of the swing outside the bounds", round);
+        // Same swing the other way round covers the other half
+        SweptCapsule back = make_swept_capsule(500.0f, 500.0f, to, from, true, inner, outer, PLAYER_RADIUS);
+        uint16_t behind[1];
+        expect(capsule_hits_scalar(back, &xs[0], &ys[0], 1, behind) == 1, "half turn back: other half not hit", round);
+    }
+}
+
+int main() {
+#if defined(__AVX__)
+    if (!__builtin_cpu_supports("avx")) {
+        printf("kernel_check (AVX): skipped, this CPU has no AVX\n");
+        return 0;
+    }
+#endif
+    std::mt19937 rng(2024);
+    check_random_batches(rng, 20000);
+    check_half_turns();
+    if (failures) {
+        printf("kernel_check (%s): %d failures\n", vector_path(), failures);
+        return 1;
+    }
+    printf("kernel_check (%s): ok\n", vector_path());
+    return 0;
+}
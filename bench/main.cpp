@@ -0,0 +1,172 @@
+#include <iostream>
+#include <vector>
+#include <algorithm> // nth_element() for percentiles
+#include <new>
+#include <random>
+#include <atomic>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "../common/clock.h"
+#include "../server/world.h"
+
+// --- Simulation microbenchmark ---
+//
+// sim_bench links only libsmack_sim and times simulate_tick() on synthetic worlds: every combination of
+// player count, share of players attacking each tick, and score distribution (scores set newspaper length,
+// and so how many grid cells each swing has to search). For each case it prints the time per tick and how
+// much of it went to the hit tests, and how many heap allocations a tick made - which should be 0 once
+// the world is warmed up.
+//
+// Inputs are generated and scores and positions restored between ticks, outside the timed region, so every
+// tick sees the same kind of load. (Left alone, a crowd that keeps attacking knocks itself into piles against
+// the walls, and every swing into a pile hits everyone in it.)
+
+// Every operator new in the process goes through here; the benchmark reads the count around each tick.
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+enum ScoreSpread {
+    SCORES_ZERO,    // Everyone just joined: shortest newspapers
+    SCORES_UNIFORM, // 0..99 spread evenly: a mid-game mix
+    SCORES_LEADER   // One player at 99, the rest at 0: one very long swing
+};
+
+static const char* SPREAD_NAMES[] = {"zero", "uniform", "leader"};
+
+struct BenchCase {
+    int players;
+    float attack_share; // Fraction of players attacking each tick
+    ScoreSpread spread;
+};
+
+struct BenchResult {
+    double mean_ns;
+    double collision_ns; // Mean time in resolve_attacks(), the part of the tick that grows with attackers
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    double allocations_per_tick;
+};
+
+static uint64_t percentile(std::vector<uint64_t>& samples, double fraction) {
+    if (samples.empty()) return 0;
+    size_t k = (size_t)(fraction * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+static BenchResult run_case(const BenchCase& bench, int ticks) {
+    const float dt = 1.0f / DEFAULT_TICK_RATE;
+    std::mt19937 rng(12345); // Same seed for every case and every run
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    World world;
+    world.init(bench.players, 0);
+    std::vector<uint32_t> scores(bench.players);
+    std::vector<std::pair<float, float> > spots(bench.players); // Starting positions
+    for (int i = 0; i < bench.players; i++) {
+        world.spawn(i);
+        world.x[i] = PLAYER_RADIUS + unit(rng) * (MAP_WIDTH - 2 * PLAYER_RADIUS);
+        world.y[i] = PLAYER_RADIUS + unit(rng) * (MAP_HEIGHT - 2 * PLAYER_RADIUS);
+        world.rotation[i] = unit(rng) * 6.2831853f;
+        spots[i] = std::make_pair(world.x[i], world.y[i]);
+        if (bench.spread == SCORES_UNIFORM) scores[i] = (uint32_t)(unit(rng) * 100.0f);
+        else if (bench.spread == SCORES_LEADER) scores[i] = i == 0 ? 99 : 0;
+        else scores[i] = 0;
+    }
+
+    std::vector<PlayerCommand> commands(bench.players);
+    std::vector<uint64_t> tick_ns;
+    tick_ns.reserve(ticks);
+    uint64_t allocated = 0;
+    uint64_t collision_sum = 0;
+    const int warmup = 10; // Lets every scratch vector reach its working size first
+    for (int t = 0; t < warmup + ticks; t++) {
+        for (int i = 0; i < bench.players; i++) {
+            PlayerCommand& cmd = commands[i];
+            cmd.present = 1;
+            cmd.dx = unit(rng) * 2.0f - 1.0f;
+            cmd.dy = unit(rng) * 2.0f - 1.0f;
+            cmd.rotation = world.rotation[i] + 0.1f; // Keep swinging so attacks sweep
+            cmd.attack = unit(rng) < bench.attack_share;
+            cmd.rewind_tick = 0;
+        }
+        std::copy(scores.begin(), scores.end(), world.score.begin()); // Hold the distributions steady
+        for (int i = 0; i < bench.players; i++) {
+            world.x[i] = spots[i].first;
+            world.y[i] = spots[i].second;
+        }
+
+        uint64_t allocations_before = allocations.load(std::memory_order_relaxed);
+        uint64_t start = monotonic_ns();
+        move_players(world, commands, dt); // simulate_tick(), timed in its two halves
+        uint64_t moved = monotonic_ns();
+        resolve_attacks(world, commands);
+        uint64_t end = monotonic_ns();
+        if (t < warmup) continue;
+        tick_ns.push_back(end - start);
+        collision_sum += end - moved;
+        allocated += allocations.load(std::memory_order_relaxed) - allocations_before;
+    }
+
+    BenchResult result;
+    uint64_t sum = 0;
+    for (size_t k = 0; k < tick_ns.size(); k++) sum += tick_ns[k];
+    result.mean_ns = (double)sum / tick_ns.size();
+    result.collision_ns = (double)collision_sum / tick_ns.size();
+    result.p50_ns = percentile(tick_ns, 0.50);
+    result.p99_ns = percentile(tick_ns, 0.99);
+    result.allocations_per_tick = (double)allocated / ticks;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    int ticks = 200;
+    int only_players = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            ticks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--players") == 0 && i + 1 < argc) {
+            only_players = atoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--ticks N] [--players N]\n";
+            return 1;
+        }
+    }
+    if (ticks < 1 || only_players < 0 || only_players > MAX_PLAYERS_LIMIT) {
+        std::cerr << "--ticks must be at least 1, --players between 1 and " << MAX_PLAYERS_LIMIT << "\n";
+        return 1;
+    }
+
+    const int player_counts[] = {4, 64, 1000, 10000};
+    const float attack_shares[] = {0.0f, 0.1f, 0.5f};
+    std::vector<int> counts(player_counts, player_counts + 4);
+    if (only_players) counts.assign(1, only_players);
+
+    printf("%8s %8s %8s %12s %12s %12s %12s %10s\n", "players", "attack", "scores", "mean ns", "hits ns", "p50 ns", "p99 ns",
+           "allocs");
+    for (size_t c = 0; c < counts.size(); c++) {
+        for (int a = 0; a < 3; a++) {
+            for (int s = 0; s < 3; s++) {
+                if (attack_shares[a] == 0.0f && s > 0) continue; // Scores only matter to swings
+                BenchCase bench;
+                bench.players = counts[c];
+                bench.attack_share = attack_shares[a];
+                bench.spread = (ScoreSpread)s;
+                BenchResult r = run_case(bench, ticks);
+                printf("%8d %7.0f%% %8s %12.0f %12.0f %12llu %12llu %10.2f\n", bench.players, bench.attack_share * 100.0f,
+                       SPREAD_NAMES[s], r.mean_ns, r.collision_ns, (unsigned long long)r.p50_ns, (unsigned long long)r.p99_ns,
+                       r.allocations_per_tick);
+            }
+        }
+    }
+    return 0;
+}
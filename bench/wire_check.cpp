@@ -0,0 +1,520 @@
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "../common/protocol.h"
+#include "../common/snapshot.h"
+#include "../common/stream_buffer.h"
+
+// --- Wire format check ---
+//
+// Round-trips every packet schema in protocol.h, pins the encoded sizes and byte order, and exercises the
+// parts of wire.h a plain round trip never reaches: decoding the shorter packets of an older build and the
+// longer ones of a newer build, the limits of the quantized codecs, and splitting a UDP input batch by
+// its inferred stride, and checks that the TCP framing keeps payloads in place until the next recv. Then
+// it round-trips snapshots through encode_snapshot() and decode_snapshot(), full and as deltas, the way
+// the server and a client each keep their own SnapshotRing.
+
+static int failures = 0;
+
+static void expect(bool ok, const char* what) {
+    if (ok) return;
+    failures++;
+    printf("FAIL: %s\n", what);
+}
+
+// Encodes `packet`, checks the size, decodes it back into a garbage-filled struct.
+template <class T>
+static T round_trip(const T& packet, size_t expected_size, const char* what) {
+    uint8_t buffer[64];
+    memset(buffer, 0xCD, sizeof(buffer));
+    expect(wire::encode(buffer, packet) == buffer + expected_size, what);
+    T back;
+    memset(&back, 0xAB, sizeof(back));
+    expect(wire::decode(buffer, expected_size, back), what);
+    return back;
+}
+
+// --- Every schema ---
+
+static void check_schemas(std::mt19937& rng) {
+    expect(FRAME_HEADER_SIZE == 5 && INPUT_PACKET_SIZE == 20 && GAME_STATE_HEADER_SIZE == 18 &&
+           DATAGRAM_HEADER_SIZE == 21 && wire::Size<JoinPacket>::value == 3 && wire::Size<AckPacket>::value == 4 &&
+           wire::Size<WelcomePacket>::value == 12, "encoded sizes changed (that's a protocol change)");
+
+    // Integers go out little-endian whatever the host
+    AckPacket ack;
+    ack.ack = 0x04030201;
+    uint8_t bytes[4];
+    wire::encode(bytes, ack);
+    expect(bytes[0] == 1 && bytes[1] == 2 && bytes[2] == 3 && bytes[3] == 4, "AckPacket isn't little-endian");
+
+    for (int round = 0; round < 1000; round++) {
+        // Alternate between random values and every field at its maximum
+        bool extreme = round % 2 == 1;
+        uint32_t r32 = extreme ? 0xFFFFFFFFu : (uint32_t)rng();
+        uint16_t r16 = extreme ? 0xFFFF : (uint16_t)rng();
+        uint8_t r8 = extreme ? 0xFF : (uint8_t)rng();
+
+        FrameHeader frame;
+        frame.length = r32;
+        frame.type = (PacketType)(r8 % 6);
+        FrameHeader frame_back = round_trip(frame, FRAME_HEADER_SIZE, "FrameHeader round trip");
+        expect(frame_back.length == frame.length && frame_back.type == frame.type, "FrameHeader fields");
+
+        // Quantized fields only round-trip exactly from values the codec can represent
+        InputPacket input;
+        input.id = r16;
+        input.seq = r32;
+        input.ack = r32 ^ 0x5A5A5A5A;
+        input.dx = (int)(rng() % 255 - 127) / 127.0f;
+        input.dy = extreme ? -1.0f : (int)(rng() % 255 - 127) / 127.0f;
+        input.rotation = (int16_t)rng() * (float)(wire::HALF_TURN / 32768.0);
+        input.attack = r8 & 1;
+        input.view_tick = r32 - 7;
+        input.view_fraction = r8;
+        InputPacket input_back = round_trip(input, INPUT_PACKET_SIZE, "InputPacket round trip");
+        expect(input_back.id == input.id && input_back.seq == input.seq && input_back.ack == input.ack &&
+               input_back.dx == input.dx && input_back.dy == input.dy && input_back.rotation == input.rotation &&
+               input_back.attack == input.attack && input_back.view_tick == input.view_tick &&
+               input_back.view_fraction == input.view_fraction, "InputPacket fields");
+
+        GameStatePacket state;
+        state.seq = r32;
+        state.baseline = r32 - 1;
+        state.server_time = r32 ^ 0xFFFF;
+        state.last_input = r32 >> 3;
+        state.count = r16;
+        GameStatePacket state_back = round_trip(state, GAME_STATE_HEADER_SIZE, "GameStatePacket round trip");
+        expect(state_back.seq == state.seq && state_back.baseline == state.baseline &&
+               state_back.server_time == state.server_time && state_back.last_input == state.last_input &&
+               state_back.count == state.count, "GameStatePacket fields");
+
+        JoinPacket join;
+        join.room = r16;
+        join.version = r8;
+        JoinPacket join_back = round_trip(join, 3, "JoinPacket round trip");
+        expect(join_back.room == join.room && join_back.version == join.version, "JoinPacket fields");
+
+        ack.ack = r32;
+        expect(round_trip(ack, 4, "AckPacket round trip").ack == ack.ack, "AckPacket fields");
+
+        WelcomePacket welcome;
+        welcome.assigned_id = r16;
+        welcome.tick_rate = (uint16_t)(r16 >> 1);
+        welcome.udp_token = r32;
+        welcome.room = (uint16_t)(r16 ^ 0x00FF);
+        welcome.udp_port = (uint16_t)(r16 + 1);
+        WelcomePacket welcome_back = round_trip(welcome, 12, "WelcomePacket round trip");
+        expect(welcome_back.assigned_id == welcome.assigned_id && welcome_back.tick_rate == welcome.tick_rate &&
+               welcome_back.udp_token == welcome.udp_token && welcome_back.room == welcome.room &&
+               welcome_back.udp_port == welcome.udp_port, "WelcomePacket fields");
+
+        DatagramHeader dh;
+        dh.token = r32;
+        dh.room = r16;
+        dh.id = (uint16_t)(r16 >> 2);
+        dh.type = (PacketType)(r8 % 6);
+        dh.seq = r32 + 11;
+        dh.ack = r32 >> 1;
+        dh.ack_bits = ~r32;
+        DatagramHeader dh_back = round_trip(dh, DATAGRAM_HEADER_SIZE, "DatagramHeader round trip");
+        expect(dh_back.token == dh.token && dh_back.room == dh.room && dh_back.id == dh.id && dh_back.type == dh.type &&
+               dh_back.seq == dh.seq && dh_back.ack == dh.ack && dh_back.ack_bits == dh.ack_bits, "DatagramHeader fields");
+    }
+}
+
+// --- Versioning ---
+
+// Today every shipped field is version 1, so the older-build path needs a schema of its own: a packet as
+// it would look after two protocol bumps.
+struct Evolved {
+    uint32_t a;   // Version 1
+    uint16_t b;   // Version 2
+    float c;      // Version 3
+    uint8_t d;    // Version 3
+};
+
+namespace wire {
+template <> struct Schema<Evolved> : Layout<
+    WIRE_FIELD(Evolved, a, U32, 1),
+    WIRE_FIELD(Evolved, b, U16, 2),
+    WIRE_FIELD(Evolved, c, F32, 3),
+    WIRE_FIELD(Evolved, d, U8, 3)
+> {};
+} // namespace wire
+
+static_assert(wire::Schema<Evolved>::size == 11, "Evolved is 11 bytes");
+static_assert(wire::Schema<Evolved>::required_size == 4, "only the version 1 prefix is required");
+static_assert(wire::Schema<Evolved>::version == 3, "Evolved's newest field is version 3");
+static_assert(wire::Schema<InputPacket>::required_size == INPUT_PACKET_SIZE, "InputPacket is all version 1");
+
+static void check_versions() {
+    Evolved sent;
+    sent.a = 0xDEADBEEF;
+    sent.b = 0x1234;
+    sent.c = -2.5f;
+    sent.d = 0x77;
+    uint8_t buffer[32];
+    memset(buffer, 0xEE, sizeof(buffer)); // A newer build's extra fields, as far as we can tell
+    wire::encode(buffer, sent);
+
+    for (size_t length = 0; length <= sizeof(buffer); length++) {
+        Evolved got;
+        memset(&got, 0xAB, sizeof(got));
+        bool ok = wire::decode(buffer, length, got);
+        if (length < 4) {
+            expect(!ok, "decode accepted a packet without its version 1 fields");
+            continue;
+        }
+        expect(ok, "decode refused a packet with its version 1 fields");
+        expect(got.a == sent.a, "version 1 field");
+        // A field arrives whole or is zero: never half of one
+        expect(got.b == (length >= 6 ? sent.b : 0), "version 2 field from an older or newer peer");
+        expect(got.c == (length >= 10 ? sent.c : 0.0f), "version 3 field from an older or newer peer");
+        expect(got.d == (length >= 11 ? sent.d : 0), "second version 3 field from an older or newer peer");
+    }
+
+    // Today's packets: anything short of the whole thing is refused, anything longer decodes the prefix
+    InputPacket input{};
+    input.seq = 42;
+    uint8_t longer[INPUT_PACKET_SIZE + 8];
+    memset(longer, 0x11, sizeof(longer));
+    wire::encode(longer, input);
+    for (size_t length = 0; length < INPUT_PACKET_SIZE; length++) {
+        InputPacket got;
+        expect(!wire::decode(longer, length, got), "decode accepted a truncated InputPacket");
+    }
+    InputPacket got;
+    expect(wire::decode(longer, sizeof(longer), got) && got.seq == 42 && got.view_fraction == 0,
+           "a newer peer's longer InputPacket doesn't decode");
+}
+
+// --- Quantized codecs ---
+
+static float unit8(float value) {
+    uint8_t byte;
+    wire::Unit8::put(&byte, value);
+    return wire::Unit8::get(&byte);
+}
+
+static uint16_t angle16_bits(float radians) {
+    uint8_t bytes[2];
+    wire::Angle16::put(bytes, radians);
+    return wire::U16::get(bytes);
+}
+
+static float angle16(float radians) {
+    uint8_t bytes[2];
+    wire::Angle16::put(bytes, radians);
+    return wire::Angle16::get(bytes);
+}
+
+// Distance between two angles around the circle
+static double angle_error(double a, double b) {
+    double d = fmod(a - b, 2.0 * wire::HALF_TURN);
+    if (d > wire::HALF_TURN) d -= 2.0 * wire::HALF_TURN;
+    if (d < -wire::HALF_TURN) d += 2.0 * wire::HALF_TURN;
+    return fabs(d);
+}
+
+static void check_quantization(std::mt19937& rng) {
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    expect(unit8(0.0f) == 0.0f && unit8(1.0f) == 1.0f && unit8(-1.0f) == -1.0f, "Unit8 doesn't keep 0 and +-1 exact");
+    expect(unit8(1.5f) == 1.0f && unit8(-7.0f) == -1.0f && unit8(NAN) == -1.0f, "Unit8 doesn't clamp");
+    for (int k = -127; k <= 127; k++) expect(unit8(k / 127.0f) == k / 127.0f, "Unit8 step doesn't round-trip");
+    for (int k = 0; k < 10000; k++) {
+        float v = unit(rng);
+        expect(fabsf(unit8(v) - v) <= 0.5f / 127.0f + 1e-6f, "Unit8 error over half a step");
+        expect(unit8(unit8(v)) == unit8(v), "Unit8 isn't idempotent (prediction would drift from the server)");
+    }
+
+    const float step = (float)(wire::HALF_TURN / 32768.0);
+    const float half_turn = (float)wire::HALF_TURN;
+    expect(angle16(0.0f) == 0.0f, "Angle16 doesn't keep 0");
+    expect(angle16_bits(step) == 1 && angle16_bits(-step) == 0xFFFF, "Angle16 one step either side of 0");
+    // Half a turn either way is the same angle, and decodes to -pi so the range is [-pi, pi)
+    expect(angle16_bits(half_turn) == 0x8000 && angle16_bits(-half_turn) == 0x8000, "Angle16 at +-pi");
+    expect(angle16(half_turn) == -half_turn, "Angle16 doesn't decode pi as -pi");
+    // Whole turns wrap away, however many of them the client's rotation has accumulated
+    for (int turns = -3; turns <= 3; turns++) {
+        expect(angle16_bits(turns * 2.0f * half_turn) == 0, "Angle16 doesn't wrap whole turns to 0");
+    }
+    for (int k = 0; k < 10000; k++) {
+        float a = unit(rng) * 20.0f;
+        float back = angle16(a);
+        expect(back >= -half_turn && back < half_turn, "Angle16 decoded outside [-pi, pi)");
+        expect(angle_error(back, a) <= step * 0.5 + 1e-5, "Angle16 error over half a step");
+        expect(angle16(back) == back, "Angle16 isn't idempotent");
+        expect(angle_error(angle16(a + 2.0f * half_turn), back) <= step + 1e-5, "Angle16 differs a turn later");
+    }
+}
+
+// --- UDP input batches ---
+
+// A datagram body as a build whose InputPacket is `stride` bytes would send it.
+static std::vector<uint8_t> input_batch(int count, size_t stride) {
+    std::vector<uint8_t> body(1 + count * stride, 0x5C);
+    body[0] = (uint8_t)count;
+    for (int k = 0; k < count; k++) {
+        InputPacket input{};
+        input.seq = 100 + k;
+        input.attack = 1;
+        uint8_t encoded[INPUT_PACKET_SIZE];
+        wire::encode(encoded, input);
+        memcpy(&body[1 + k * stride], encoded, stride < INPUT_PACKET_SIZE ? stride : INPUT_PACKET_SIZE);
+    }
+    return body;
+}
+
+// Splits and decodes a batch the way Room::on_datagram does. Returns how many inputs came out in order.
+static int decode_batch(const std::vector<uint8_t>& body) {
+    size_t stride = input_batch_stride(body.data(), body.size());
+    if (stride == 0) return -1;
+    for (int k = 0; k < body[0]; k++) {
+        InputPacket input;
+        if (!wire::decode(&body[1 + k * stride], stride, input)) return -2;
+        if (input.seq != (uint32_t)(100 + k) || input.attack != 1) return -3;
+    }
+    return body[0];
+}
+
+static void check_input_batches() {
+    for (int count = 1; count <= REDUNDANT_INPUTS; count++) {
+        std::vector<uint8_t> body = input_batch(count, INPUT_PACKET_SIZE);
+        expect(input_batch_stride(body.data(), body.size()) == INPUT_PACKET_SIZE, "stride of a same-version batch");
+        expect(decode_batch(body) == count, "same-version batch doesn't decode");
+        // A newer build's longer inputs: the stride grows and the unknown tail of each is skipped
+        expect(decode_batch(input_batch(count, INPUT_PACKET_SIZE + 3)) == count, "newer peer's batch doesn't decode");
+        // An input shorter than the version 1 fields splits evenly but must not decode
+        expect(decode_batch(input_batch(count, INPUT_PACKET_SIZE - 2)) == -2, "truncated inputs decoded");
+
+        body.push_back(0); // One stray byte: no longer divides evenly (a single input just looks newer)
+        if (count > 1) expect(input_batch_stride(body.data(), body.size()) == 0, "ragged batch accepted");
+    }
+    uint8_t empty[1] = {0};
+    expect(input_batch_stride(empty, 0) == 0 && input_batch_stride(empty, 1) == 0, "empty batch accepted");
+    std::vector<uint8_t> too_many = input_batch(REDUNDANT_INPUTS + 1, INPUT_PACKET_SIZE);
+    expect(input_batch_stride(too_many.data(), too_many.size()) == 0, "over-long batch accepted");
+}
+
+// --- TCP framing ---
+
+// Callers remember the newest snapshot of a batch and decode it once next_frame() says NEED_MORE, so a
+// payload has to survive that call even when the unfinished frame behind it needs a bigger buffer.
+static void check_stream_framing() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        expect(false, "framing: socketpair() failed");
+        return;
+    }
+    std::vector<uint8_t> bytes(FRAME_HEADER_SIZE + 40);
+    write_frame_header(bytes.data(), STATE_UPDATE, 40);
+    for (int k = 0; k < 40; k++) bytes[FRAME_HEADER_SIZE + k] = (uint8_t)(k + 1);
+    bytes.resize(bytes.size() + FRAME_HEADER_SIZE + 10); // Head of a frame ten times the buffer's size
+    write_frame_header(bytes.data() + FRAME_HEADER_SIZE + 40, STATE_UPDATE, 1000);
+    for (size_t k = FRAME_HEADER_SIZE * 2 + 40; k < bytes.size(); k++) bytes[k] = 0xEE;
+    expect(send(fds[0], bytes.data(), bytes.size(), 0) == (ssize_t)bytes.size(), "framing: send() was short");
+
+    StreamBuffer rx(64, 4096);
+    FrameHeader header;
+    const uint8_t* payload = NULL;
+    expect(rx.recv_from(fds[1]) == (ssize_t)bytes.size(), "framing: recv() was short");
+    const uint8_t* kept = NULL;
+    expect(rx.next_frame(header, kept) == StreamBuffer::FRAME && header.length == 40, "framing: first frame");
+    expect(rx.next_frame(header, payload) == StreamBuffer::NEED_MORE, "framing: partial frame handed out");
+    const uint8_t* buffer = rx.data.data();
+    expect(rx.data.size() == 64 && kept >= buffer && kept + 40 <= buffer + 64, "framing: NEED_MORE moved the buffer");
+    bool intact = true;
+    for (int k = 0; k < 40; k++) intact = intact && kept[k] == k + 1;
+    expect(intact, "framing: NEED_MORE overwrote a payload");
+
+    // The rest arrives: recv_from() makes room, and the big frame comes out whole
+    std::vector<uint8_t> rest(1000 - 10, 0xEE);
+    expect(send(fds[0], rest.data(), rest.size(), 0) == (ssize_t)rest.size(), "framing: send() was short");
+    size_t received = 0;
+    while (received < rest.size()) {
+        ssize_t n = rx.recv_from(fds[1]);
+        if (n <= 0) break;
+        received += (size_t)n;
+    }
+    expect(received == rest.size(), "framing: the rest didn't fit");
+    expect(rx.next_frame(header, payload) == StreamBuffer::FRAME && header.length == 1000, "framing: big frame");
+    expect(rx.next_frame(header, payload) == StreamBuffer::NEED_MORE && rx.readable() == 0, "framing: leftovers");
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// --- Snapshots ---
+
+static bool same_entities(const std::vector<EntityState>& a, const std::vector<EntityState>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t k = 0; k < a.size(); k++) {
+        if (a[k].id != b[k].id || a[k].x != b[k].x || a[k].y != b[k].y || a[k].rotation != b[k].rotation ||
+            a[k].score != b[k].score || a[k].is_attacking != b[k].is_attacking) return false;
+    }
+    return true;
+}
+
+static EntityState entity(uint16_t id, uint16_t x, uint16_t y, uint16_t rotation, uint32_t score, uint8_t attacking) {
+    EntityState e;
+    e.id = id;
+    e.x = x;
+    e.y = y;
+    e.rotation = rotation;
+    e.score = score;
+    e.is_attacking = attacking;
+    return e;
+}
+
+// Encodes `current` against `baseline` (if any) and decodes it with the client's `history`. False if the
+// decode fails; otherwise the decoded snapshot must match `current` exactly.
+static bool snapshot_round_trip(const Snapshot& current, const Snapshot* baseline, const SnapshotRing& history,
+                                const char* what) {
+    std::vector<uint8_t> payload;
+    encode_snapshot(current, baseline, payload);
+    Snapshot decoded;
+    if (!decode_snapshot(payload.data(), payload.size(), history, decoded)) return false;
+    expect(decoded.seq == current.seq && decoded.server_time == current.server_time &&
+           same_entities(decoded.entities, current.entities), what);
+    return true;
+}
+
+static void check_snapshots(std::mt19937& rng) {
+    SnapshotRing client;
+
+    // No baseline, with gaps in the ids, both ends of the id range, and scores either side of the 7-bit
+    // short form up to the largest a uint32_t holds
+    Snapshot full;
+    full.seq = 1;
+    full.server_time = 0xFFFFFFF0u;
+    full.entities.push_back(entity(0, 0, 65535, 0, 0, 0));
+    full.entities.push_back(entity(1, 100, 200, 4095, 127, 1));
+    full.entities.push_back(entity(7, 16384, 16384, 2048, 128, 0));
+    full.entities.push_back(entity(1000, 65535, 0, 1, 0x7FFFFFFFu, 1));
+    full.entities.push_back(entity(MAX_PLAYERS_LIMIT - 1, 12345, 54321, 777, 0xFFFFFFFFu, 0));
+    expect(snapshot_round_trip(full, NULL, client, "full snapshot"), "full snapshot doesn't decode");
+    Snapshot& full_client = client.insert(full.seq);
+    full_client = full;
+
+    // A delta against it: one moved and turned, one's score jumped to a full 32-bit value, one left, one
+    // joined between existing ids, and the rest are unchanged (and so not sent at all)
+    Snapshot delta = full;
+    delta.seq = 2;
+    delta.server_time = 5; // Clock wrapped
+    delta.entities[1].x = 101;
+    delta.entities[1].rotation = 0;
+    delta.entities[2].score = 0xFFFFFFFEu;
+    delta.entities.erase(delta.entities.begin() + 3); // id 1000 leaves
+    delta.entities.insert(delta.entities.begin() + 3, entity(500, 1, 2, 3, 4, 1));
+    std::vector<uint8_t> payload;
+    encode_snapshot(delta, &full, payload);
+    GameStatePacket header;
+    wire::read(payload.data(), header);
+    expect(header.baseline == 1 && header.count == 4, "delta should carry 2 changes, 1 removal and 1 join");
+    expect(snapshot_round_trip(delta, &full, client, "delta snapshot"), "delta snapshot doesn't decode");
+
+    // Everyone leaves
+    Snapshot gone;
+    gone.seq = 3;
+    expect(snapshot_round_trip(gone, &full, client, "all removed"), "all-removed delta doesn't decode");
+
+    // Nothing changed: a header and no records
+    Snapshot same = full;
+    same.seq = 4;
+    payload.clear();
+    encode_snapshot(same, &full, payload);
+    expect(payload.size() == GAME_STATE_HEADER_SIZE, "an unchanged snapshot should be just the header");
+    expect(snapshot_round_trip(same, &full, client, "unchanged snapshot"), "unchanged delta doesn't decode");
+
+    // A full room turning over: every even id leaves and every odd one joins, so the delta carries a record
+    // for each id the player cap allows - the most the 16-bit count ever has to hold
+    Snapshot evens, odds;
+    evens.seq = 10;
+    odds.seq = 11;
+    for (uint32_t id = 0; id < MAX_PLAYERS_LIMIT; id++) {
+        (id % 2 ? odds : evens).entities.push_back(entity((uint16_t)id, (uint16_t)id, 7, 9, id, 0));
+    }
+    client.insert(evens.seq) = evens;
+    payload.clear();
+    encode_snapshot(odds, &evens, payload);
+    wire::read(payload.data(), header);
+    expect(header.count == MAX_PLAYERS_LIMIT, "turnover delta should carry a record per id");
+    expect(snapshot_round_trip(odds, &evens, client, "turnover delta"), "turnover delta doesn't decode");
+
+    // Truncated payloads are refused, never read past
+    payload.clear();
+    encode_snapshot(full, NULL, payload);
+    for (size_t length = 0; length < payload.size(); length++) {
+        Snapshot decoded;
+        expect(!decode_snapshot(payload.data(), length, client, decoded), "truncated snapshot decoded");
+    }
+
+    // The baseline has left the client's ring: the decode must fail so the client keeps acking its older one
+    for (uint32_t seq = 2; seq <= 1 + SNAPSHOT_HISTORY; seq++) client.insert(seq);
+    expect(client.find(1) == NULL, "ring should have evicted seq 1");
+    expect(!snapshot_round_trip(delta, &full, client, "aged-out baseline"), "decoded against an evicted baseline");
+
+    // A long random run: the client acks a few ticks late, sometimes not at all for a while, and the server
+    // diffs against whatever it last acked while it still has it
+    SnapshotRing server_ring, client_ring;
+    std::vector<EntityState> players;
+    uint32_t acked = 0;
+    for (uint32_t seq = 1; seq <= 2000; seq++) {
+        std::vector<EntityState> next;
+        for (size_t k = 0; k < players.size(); k++) {
+            if (rng() % 50 == 0) continue; // Leaves
+            EntityState e = players[k];
+            if (rng() % 2) e.x = (uint16_t)rng(), e.y = (uint16_t)rng();
+            if (rng() % 3 == 0) e.rotation = (uint16_t)(rng() & 4095);
+            if (rng() % 10 == 0) e.score = rng() % 4 == 0 ? (uint32_t)rng() : e.score + 1;
+            e.is_attacking = rng() % 4 == 0;
+            next.push_back(e);
+        }
+        for (int join = rng() % 3; join > 0; join--) { // Joins at random ids, leaving gaps
+            uint16_t id = (uint16_t)(rng() % 300);
+            bool taken = false;
+            for (size_t k = 0; k < next.size(); k++) taken = taken || next[k].id == id;
+            if (!taken) next.push_back(entity(id, (uint16_t)rng(), (uint16_t)rng(), 0, 0, 0));
+        }
+        std::sort(next.begin(), next.end(), [](const EntityState& a, const EntityState& b) { return a.id < b.id; });
+        players = next;
+
+        Snapshot& current = server_ring.insert(seq);
+        current.server_time = seq * 16667;
+        current.entities = players;
+        const Snapshot* baseline = server_ring.find(acked);
+        payload.clear();
+        encode_snapshot(current, baseline, payload);
+
+        if (rng() % 5 == 0) continue; // Lost on the way
+        Snapshot& decoded = client_ring.insert(seq);
+        if (!decode_snapshot(payload.data(), payload.size(), client_ring, decoded)) {
+            decoded.seq = 0; // Not usable as a baseline
+            expect(baseline != NULL, "random run: full snapshot didn't decode");
+            continue;
+        }
+        expect(same_entities(decoded.entities, players), "random run: decoded snapshot differs");
+        if (rng() % 3 != 0) acked = seq; // Ack some of what arrived
+    }
+}
+
+int main() {
+    std::mt19937 rng(7);
+    check_schemas(rng);
+    check_versions();
+    check_quantization(rng);
+    check_input_batches();
+    check_stream_framing();
+    check_snapshots(rng);
+    if (failures) {
+        printf("wire_check: %d failures\n", failures);
+        return 1;
+    }
+    printf("wire_check: ok\n");
+    return 0;
+}
@@ -0,0 +1,435 @@
+#include <iostream>
+#include <fstream>  // --script files
+#include <sstream>
+#include <vector>
+#include <algorithm> // nth_element() for percentiles
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h> // for TCP_NODELAY
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h> // setrlimit(): one descriptor per bot (two with --udp)
+#include <random>
+#include "../common/protocol.h"
+#include "../common/stream_buffer.h"
+#include "../common/snapshot.h"
+#include "../common/ack_tracker.h"
+#include "../common/clock.h"
+
+// --- Headless load generator ---
+//
+// bot_app opens N connections from one process and plays like N real clients (join, send one input per
+// tick, decode and ack every snapshot) without a window. It reports:
+//   - latency:  server_time in each snapshot -> the moment the bot decoded it. Both ends read the same
+//               CLOCK_MONOTONIC, so this is only meaningful when the bots run on the server's host.
+//   - snapshot rate per bot, and jitter: how much the gap between consecutive snapshots varies.
+// Run it against a build before and after a change to see what the change did to the server.
+
+static const uint32_t TIMER_TAG = 0xFFFFFFFFu; // epoll tag of the input clock; bots use their index
+static const int UDP_FLAG = 0x40000000;        // Set in a bot's tag for events on its UDP socket
+
+struct BotConfig {
+    const char* server_ip = "127.0.0.1";
+    int bots = 10;
+    int rate = 0;           // Inputs per second per bot; 0 = the server's tick rate
+    double duration = 10.0; // Seconds to measure, after every bot has joined
+    uint16_t room = ANY_ROOM;
+    bool udp = false;
+    const char* script = NULL; // File of "dx dy rotation attack" lines, played in a loop
+};
+
+// One scripted step. Random bots make up their own.
+struct ScriptStep {
+    float dx;
+    float dy;
+    float rotation;
+    uint8_t attack;
+};
+
+struct Bot {
+    int fd = -1;
+    int udp_fd = -1;
+    bool joined = false;
+    uint16_t id = 0;
+    uint16_t room = 0;
+    uint32_t udp_token = 0;
+    StreamBuffer rx{4096, GAME_STATE_HEADER_SIZE + sizeof(EntityState) * MAX_PLAYERS_LIMIT};
+    SendBuffer tx{16 * 1024}; // Inputs the socket didn't take yet; a server that reads none for seconds is gone
+
+    SnapshotRing snapshots;
+    uint32_t last_snapshot = 0;
+    AckTracker snapshot_acks;
+    uint64_t last_arrival_us = 0;
+
+    uint32_t input_seq = 0;
+    uint32_t server_acked_input = 0;
+    InputPacket recent_inputs[REDUNDANT_INPUTS];
+    ScriptStep wander; // Random bots: current direction, changed every so often
+    size_t script_pos = 0;
+};
+
+// Samples collected while measuring
+struct Stats {
+    std::vector<uint32_t> latency_us;
+    std::vector<uint32_t> gap_us; // Time between two snapshots arriving at the same bot
+    uint64_t snapshots = 0;
+    uint64_t bytes = 0;
+    uint64_t decode_failures = 0;
+    uint64_t queued_inputs = 0; // Inputs the socket didn't take in full, so (part of) them waited in the tx
+    uint64_t send_failures = 0; // Bots dropped because their socket failed or stopped taking inputs
+};
+
+static bool parse_args(int argc, char* argv[], BotConfig& config) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bots") == 0 && i + 1 < argc) {
+            config.bots = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            config.rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            config.duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--room") == 0 && i + 1 < argc) {
+            config.room = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--udp") == 0) {
+            config.udp = true;
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            config.script = argv[++i];
+        } else if (argv[i][0] != '-') {
+            config.server_ip = argv[i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [SERVER_IP] [--bots N] [--rate HZ] [--duration S] [--room N]"
+                      << " [--udp] [--script FILE]\n";
+            return false;
+        }
+    }
+    if (config.bots < 1 || config.rate < 0 || config.rate > 1000 || config.duration <= 0.0) {
+        std::cerr << "--bots must be at least 1, --rate between 0 and 1000, --duration positive\n";
+        return false;
+    }
+    return true;
+}
+
+static bool load_script(const char* path, std::vector<ScriptStep>& steps) {
+    std::ifstream file(path);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        ScriptStep step;
+        int attack = 0;
+        if (!(fields >> step.dx >> step.dy >> step.rotation >> attack)) continue;
+        step.attack = attack ? 1 : 0;
+        steps.push_back(step);
+    }
+    return !steps.empty();
+}
+
+// Value below which `fraction` of the samples fall. Reorders the samples.
+static uint32_t percentile(std::vector<uint32_t>& samples, double fraction) {
+    if (samples.empty()) return 0;
+    size_t k = (size_t)(fraction * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+static void print_report(Stats& stats, double seconds, int bots) {
+    double mean_gap = 0.0;
+    for (size_t k = 0; k < stats.gap_us.size(); k++) mean_gap += stats.gap_us[k];
+    if (!stats.gap_us.empty()) mean_gap /= stats.gap_us.size();
+    double variance = 0.0;
+    for (size_t k = 0; k < stats.gap_us.size(); k++) variance += (stats.gap_us[k] - mean_gap) * (stats.gap_us[k] - mean_gap);
+    if (!stats.gap_us.empty()) variance /= stats.gap_us.size();
+
+    printf("snapshots: %llu in %.1f s = %.1f/s per bot, %.1f KB/s per bot, %llu undecodable\n",
+           (unsigned long long)stats.snapshots, seconds, stats.snapshots / seconds / bots,
+           stats.bytes / seconds / bots / 1024.0, (unsigned long long)stats.decode_failures);
+    printf("latency:   p50 %.3f ms  p99 %.3f ms  p999 %.3f ms\n", percentile(stats.latency_us, 0.50) / 1000.0,
+           percentile(stats.latency_us, 0.99) / 1000.0, percentile(stats.latency_us, 0.999) / 1000.0);
+    printf("interval:  mean %.3f ms  jitter (stddev) %.3f ms  p99 %.3f ms\n", mean_gap / 1000.0,
+           sqrt(variance) / 1000.0, percentile(stats.gap_us, 0.99) / 1000.0);
+    printf("sends:     %llu inputs waited for socket space, %llu bots dropped on send\n",
+           (unsigned long long)stats.queued_inputs, (unsigned long long)stats.send_failures);
+}
+
+int main(int argc, char* argv[]) {
+    BotConfig config;
+    if (!parse_args(argc, argv, config)) return 1;
+
+    std::vector<ScriptStep> script;
+    if (config.script && !load_script(config.script, script)) {
+        std::cerr << "Could not read any \"dx dy rotation attack\" lines from " << config.script << "\n";
+        return 1;
+    }
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        rlim_t wanted = (rlim_t)config.bots * 2 + 64;
+        if (limit.rlim_cur < wanted) {
+            limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || wanted < limit.rlim_max) ? wanted : limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+    sockaddr_in serv_addr{};
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(SERVER_PORT);
+    if (inet_pton(AF_INET, config.server_ip, &serv_addr.sin_addr) <= 0) {
+        std::cerr << "Invalid address\n";
+        return 1;
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Bot> bots(config.bots);
+    std::mt19937 rng(12345); // Fixed seed: the same run sends the same inputs
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    // 1. Connect everyone and ask to join. Welcomes are picked up by the event loop.
+    int opt = 1;
+    for (int b = 0; b < config.bots; b++) {
+        Bot& bot = bots[b];
+        bot.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (bot.fd < 0 || connect(bot.fd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+            std::cerr << "Bot " << b << " could not connect: " << strerror(errno) << "\n";
+            return 1;
+        }
+        setsockopt(bot.fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        JoinPacket join;
+        join.room = config.room;
+        join.version = PROTOCOL_VERSION;
+        if (!bot.tx.send_frame(bot.fd, JOIN, join)) { // Still blocking here: it all goes or it fails
+            std::cerr << "Bot " << b << " could not join: " << strerror(errno) << "\n";
+            return 1;
+        }
+        fcntl(bot.fd, F_SETFL, fcntl(bot.fd, F_GETFL, 0) | O_NONBLOCK);
+
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET; // EPOLLOUT: room again for a backed-up tx
+        event.data.u32 = (uint32_t)b;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, bot.fd, &event);
+        bot.wander.dx = 0.0f;
+        bot.wander.dy = 0.0f;
+        bot.wander.rotation = 0.0f;
+        bot.wander.attack = 0;
+    }
+    std::cout << config.bots << " bots connected to " << config.server_ip << ", waiting for welcomes...\n";
+
+    // 2. Input clock. Armed once we know the server's tick rate (unless --rate was given).
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    epoll_event timer_event{};
+    timer_event.events = EPOLLIN;
+    timer_event.data.u32 = TIMER_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &timer_event);
+    auto arm_timer = [&](int rate) {
+        long interval_ns = 1000000000L / rate;
+        itimerspec spec{};
+        spec.it_interval.tv_sec = interval_ns / 1000000000L;
+        spec.it_interval.tv_nsec = interval_ns % 1000000000L;
+        spec.it_value = spec.it_interval;
+        timerfd_settime(timer_fd, 0, &spec, NULL);
+        std::cout << "Sending " << rate << " inputs/s per bot\n";
+    };
+    if (config.rate > 0) arm_timer(config.rate);
+
+    int joined = 0;
+    int lost = 0; // Bots whose connection closed
+    uint64_t measure_start = 0;
+    uint64_t measure_end = 0;
+    Stats stats;
+    std::vector<epoll_event> events(256);
+    Snapshot decoded;
+
+    auto drop_bot = [&](Bot& bot) {
+        close(bot.fd);
+        bot.fd = -1;
+        lost++;
+    };
+    // A bot whose tx failed: the socket errored, or the server stopped reading its inputs
+    auto send_failed = [&](Bot& bot) {
+        stats.send_failures++;
+        drop_bot(bot);
+    };
+
+    // Decode one STATE_UPDATE payload for a bot and record its timing
+    auto on_snapshot = [&](Bot& bot, const uint8_t* payload, uint32_t length) {
+        uint64_t now = monotonic_us();
+        GameStatePacket packet;
+        if (!wire::decode(payload, length, packet) || packet.seq <= bot.last_snapshot) return;
+        if (!decode_snapshot(payload, length, bot.snapshots, decoded)) {
+            if (measure_start) stats.decode_failures++;
+            return;
+        }
+        Snapshot& stored = bot.snapshots.insert(decoded.seq);
+        stored.entities.swap(decoded.entities);
+        bot.last_snapshot = stored.seq;
+        bot.snapshot_acks.received(stored.seq);
+
+        if (measure_start && now >= measure_start) {
+            stats.snapshots++;
+            stats.bytes += length;
+            stats.latency_us.push_back((uint32_t)now - decoded.server_time); // Wraps like server_time does
+            if (bot.last_arrival_us >= measure_start) stats.gap_us.push_back((uint32_t)(now - bot.last_arrival_us));
+        }
+        bot.last_arrival_us = now;
+    };
+
+    // Next input for a bot: the next script line, or a random walk that changes course about twice a second
+    auto next_input = [&](Bot& bot, InputPacket& input, int rate) {
+        if (!script.empty()) {
+            const ScriptStep& step = script[bot.script_pos++ % script.size()];
+            input.dx = step.dx;
+            input.dy = step.dy;
+            input.rotation = step.rotation;
+            input.attack = step.attack;
+            return;
+        }
+        if (rng() % (uint32_t)(rate / 2 + 1) == 0) {
+            bot.wander.dx = roundf(unit(rng));
+            bot.wander.dy = roundf(unit(rng));
+            bot.wander.attack = rng() % 4 == 0;
+        }
+        bot.wander.rotation += 0.1f; // Keep swinging so attacks exercise the swept hit test
+        if (bot.wander.rotation > 3.14159265f) bot.wander.rotation -= 6.28318531f;
+        input.dx = bot.wander.dx;
+        input.dy = bot.wander.dy;
+        input.rotation = bot.wander.rotation;
+        input.attack = bot.wander.attack;
+    };
+
+    int rate = config.rate;
+    uint64_t last_report = 0;
+    while (true) {
+        int ready = epoll_wait(epoll_fd, events.data(), (int)events.size(), 100);
+        uint64_t now = monotonic_us();
+        if (measure_start && now >= measure_end) break;
+        if (!measure_start && joined + lost == config.bots && joined > 0) {
+            measure_start = now;
+            measure_end = now + (uint64_t)(config.duration * 1000000.0);
+            last_report = now;
+            std::cout << joined << " bots joined, measuring for " << config.duration << " s\n";
+        }
+        if (measure_start && now - last_report >= 1000000) {
+            std::cout << "  " << stats.snapshots << " snapshots so far, " << (config.bots - lost) << " bots connected\n";
+            last_report = now;
+        }
+
+        for (int e = 0; e < ready; e++) {
+            uint32_t tag = events[e].data.u32;
+
+            // Input clock: every joined bot sends one input per expiration
+            if (tag == TIMER_TAG) {
+                uint64_t expirations = 0;
+                if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+                for (int b = 0; b < config.bots; b++) {
+                    Bot& bot = bots[b];
+                    if (!bot.joined || bot.fd < 0) continue;
+                    InputPacket input = {};
+                    input.id = bot.id;
+                    input.seq = ++bot.input_seq;
+                    input.ack = bot.last_snapshot;
+                    next_input(bot, input, rate);
+                    if (bot.udp_fd < 0) {
+                        if (!bot.tx.send_frame(bot.fd, INPUT, input)) send_failed(bot);
+                        else if (!bot.tx.empty() && measure_start) stats.queued_inputs++;
+                        continue;
+                    }
+                    // Same redundancy scheme as the real client
+                    bot.recent_inputs[input.seq % REDUNDANT_INPUTS] = input;
+                    uint8_t datagram[DATAGRAM_HEADER_SIZE + 1 + INPUT_PACKET_SIZE * REDUNDANT_INPUTS];
+                    DatagramHeader dh;
+                    dh.token = bot.udp_token;
+                    dh.room = bot.room;
+                    dh.id = bot.id;
+                    dh.type = INPUT;
+                    dh.seq = input.seq;
+                    dh.ack = bot.snapshot_acks.latest;
+                    dh.ack_bits = bot.snapshot_acks.bits;
+                    wire::encode_at<0>(datagram, dh);
+                    uint32_t first = input.seq >= REDUNDANT_INPUTS ? input.seq - REDUNDANT_INPUTS + 1 : 1;
+                    if (first <= bot.server_acked_input) first = bot.server_acked_input + 1;
+                    uint8_t count = 0;
+                    for (uint32_t seq = first; seq <= input.seq; seq++) {
+                        wire::encode(datagram + DATAGRAM_HEADER_SIZE + 1 + count * INPUT_PACKET_SIZE, bot.recent_inputs[seq % REDUNDANT_INPUTS]);
+                        count++;
+                    }
+                    datagram[DATAGRAM_HEADER_SIZE] = count;
+                    send(bot.udp_fd, datagram, DATAGRAM_HEADER_SIZE + 1 + count * INPUT_PACKET_SIZE, 0);
+                }
+                continue;
+            }
+
+            Bot& bot = bots[tag & ~UDP_FLAG];
+
+            // UDP snapshots
+            if (tag & UDP_FLAG) {
+                static uint8_t datagram[DATAGRAM_HEADER_SIZE + MAX_SNAPSHOT_DATAGRAM];
+                while (true) {
+                    ssize_t n = recv(bot.udp_fd, datagram, sizeof(datagram), 0);
+                    if (n < 0) break;
+                    if (n < (ssize_t)DATAGRAM_HEADER_SIZE) continue;
+                    DatagramHeader dh;
+                    wire::read(datagram, dh);
+                    if (dh.token != bot.udp_token || dh.type != STATE_UPDATE) continue;
+                    if (dh.ack > bot.server_acked_input && dh.ack <= bot.input_seq) bot.server_acked_input = dh.ack;
+                    on_snapshot(bot, datagram + DATAGRAM_HEADER_SIZE, (uint32_t)(n - DATAGRAM_HEADER_SIZE));
+                }
+                continue;
+            }
+
+            // TCP: queued inputs, then the welcome and snapshots
+            if ((events[e].events & EPOLLOUT) && bot.fd >= 0 && !bot.tx.flush(bot.fd)) send_failed(bot);
+            while (bot.fd >= 0) {
+                ssize_t bytes = bot.rx.recv_from(bot.fd);
+                if (bytes < 0 && errno == EINTR) continue;
+                if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                if (bytes <= 0) {
+                    if (!bot.joined) std::cerr << "Bot " << (tag & ~UDP_FLAG) << " was refused (server or room full)\n";
+                    drop_bot(bot);
+                    break;
+                }
+                FrameHeader header;
+                const uint8_t* payload = NULL;
+                WelcomePacket welcome;
+                while (bot.rx.next_frame(header, payload) == StreamBuffer::FRAME) {
+                    if (header.type == STATE_UPDATE) {
+                        on_snapshot(bot, payload, header.length);
+                    } else if (header.type == JOIN && !bot.joined && wire::decode(payload, header.length, welcome)) {
+                        bot.id = welcome.assigned_id;
+                        bot.room = welcome.room;
+                        bot.udp_token = welcome.udp_token;
+                        bot.joined = true;
+                        joined++;
+                        if (rate == 0) {
+                            rate = welcome.tick_rate > 0 ? welcome.tick_rate : DEFAULT_TICK_RATE;
+                            arm_timer(rate);
+                        }
+                        if (config.udp && bot.udp_token != 0) {
+                            sockaddr_in udp_addr = serv_addr;
+                            udp_addr.sin_port = htons(welcome.udp_port);
+                            bot.udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                            connect(bot.udp_fd, (struct sockaddr*)&udp_addr, sizeof(udp_addr));
+                            epoll_event event{};
+                            event.events = EPOLLIN | EPOLLET;
+                            event.data.u32 = (uint32_t)(tag | UDP_FLAG);
+                            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, bot.udp_fd, &event);
+                        }
+                    }
+                }
+            }
+        }
+        if (!measure_start && lost == config.bots) {
+            std::cerr << "No bot could join\n";
+            return 1;
+        }
+    }
+
+    double seconds = (measure_end - measure_start) / 1000000.0;
+    printf("--- %d bots (%d dropped), %d inputs/s each%s ---\n", config.bots, lost, rate, config.udp ? ", UDP" : "");
+    print_report(stats, seconds, config.bots - lost > 0 ? config.bots - lost : 1);
+    return 0;
+}
@@ -1,4 +1,9 @@
 #include <iostream>
+#include <vector>
+#include <thread> // The network runs on its own thread (network.h)
+#include <string.h>
+#include <stdio.h> // snprintf() for the win banner
+#include <stdlib.h> // atoi() for --room
 #include <math.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -6,14 +11,82 @@
 #include <sys/socket.h>
 #include "raylib.h"
 #include "../common/protocol.h"
+#include "../common/stream_buffer.h"
+#include "../common/snapshot.h"
+#include "../common/clock.h"
+#include "network.h"
+#include "render.h"
+
+// --- Prediction & interpolation ---
+// Our own player moves the moment we press a key: every input we send is also applied locally with the
+// server's movement code. When a snapshot arrives it says which of our inputs it already includes, so we
+// restart from the server's position and replay the ones it hasn't seen yet (reconciliation). Both happen
+// on the network thread (network.h), which publishes the result with each snapshot.
+// Everyone else is drawn slightly in the past, blended between the two snapshots around that moment,
+// so they glide instead of jumping once per snapshot.
+static const double INTERPOLATION_TICKS = 2.0;    // How far behind the newest snapshot remote players are drawn
+
+// Blend two angles the short way around
+static float lerp_angle(float from, float to, float t) {
+    float delta = to - from;
+    while (delta > PI) delta -= 2.0f * PI;
+    while (delta < -PI) delta += 2.0f * PI;
+    return from + delta * t;
+}
+
+// Players as they were at `render_tick` (fractional server tick), from the two stored snapshots around it.
+// Past the newest snapshot we hold the newest state rather than guess ahead.
+static void interpolate_players(const SnapshotRing& history, double render_tick, std::vector<PlayerState>& out) {
+    const Snapshot* before = NULL; // Newest snapshot at or before render_tick
+    const Snapshot* after = NULL;  // Oldest snapshot after it
+    for (int k = 0; k < SNAPSHOT_HISTORY; k++) {
+        const Snapshot& s = history.slots[k];
+        if (s.seq == 0) continue;
+        if (s.seq <= render_tick) {
+            if (!before || s.seq > before->seq) before = &s;
+        } else if (!after || s.seq < after->seq) {
+            after = &s;
+        }
+    }
+    out.clear();
+    if (!before) before = after; // Render time is older than anything we kept: show the oldest
+    if (!before) return;
+    if (!after || after == before) after = before;
+    float t = after == before ? 0.0f : (float)((render_tick - before->seq) / (double)(after->seq - before->seq));
+
+    // Both lists are sorted by id; players only in `before` are on their way out and drawn where they were
+    size_t a = 0;
+    for (size_t b = 0; b < before->entities.size(); b++) {
+        PlayerState p = dequantize(before->entities[b]);
+        while (a < after->entities.size() && after->entities[a].id < p.id) a++;
+        if (a < after->entities.size() && after->entities[a].id == p.id) {
+            PlayerState next = dequantize(after->entities[a]);
+            p.x += (next.x - p.x) * t;
+            p.y += (next.y - p.y) * t;
+            p.rotation = lerp_angle(p.rotation, next.rotation, t);
+        }
+        out.push_back(p);
+    }
+}
 
 int main(int argc, char* argv[]) {
-    // determine server IP
-    const char* server_ip = "127.0.0.1"; // Default
-    if (argc > 1) {
-        server_ip = argv[1];
+    // determine server IP and transport
+    const char* server_ip = NULL;
+    bool want_udp = false; // --udp: inputs and snapshots as datagrams (if the server offers it)
+    uint16_t wanted_room = ANY_ROOM; // --room N: join a specific room instead of the least crowded one
+    bool spectate = false; // --spectate: watch without taking a player slot
+    int port = SERVER_PORT; // --port N: e.g. a relay_app's port, to spectate through it
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--udp") == 0) want_udp = true;
+        else if (strcmp(argv[i], "--room") == 0 && i + 1 < argc) wanted_room = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--spectate") == 0) spectate = true;
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) port = atoi(argv[++i]);
+        else server_ip = argv[i];
+    }
+    if (server_ip) {
         std::cout << "Connecting to custom IP: " << server_ip << std::endl;
     } else {
+        server_ip = "127.0.0.1"; // Default
         std::cout << "No IP provided. Defaulting to localhost (127.0.0.1)" << std::endl;
     }
 
@@ -26,7 +99,7 @@ int main(int argc, char* argv[]) {
 
     sockaddr_in serv_addr{};
     serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(SERVER_PORT);
+    serv_addr.sin_port = htons(port);
     
     // Connect to localhost (127.0.0.1) for testing
     if (inet_pton(AF_INET, server_ip , &serv_addr.sin_addr) <= 0) {
@@ -43,31 +116,81 @@ int main(int argc, char* argv[]) {
     int flags = fcntl(sock, F_GETFL, 0);
     fcntl(sock, F_SETFL, flags | O_NONBLOCK);
 
-    uint8_t my_id = 0;
+    // The network thread takes over the sockets once we know who we are
+    ClientNetwork network;
+    network.sock = sock;
     bool identity_received = false;
+    uint16_t udp_port = SERVER_PORT;
 
     std::cout << "Connected to server!\n";
 
+    // Say which room we want; the server answers with a WelcomePacket (or closes if that room is full)
+    JoinPacket join;
+    join.room = wanted_room;
+    join.version = PROTOCOL_VERSION;
+    if (!network.tx.send_frame(sock, spectate ? SPECTATE : JOIN, join)) {
+        std::cerr << "Connection error while joining: " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    StreamBuffer& rx = network.rx;
+    FrameHeader header;
+    const uint8_t* payload = NULL;
+
     std::cout << "Waiting for ID from server...\n";
     while (!identity_received) {
-        WelcomePacket welcome;
-        int bytes = recv(sock, &welcome, sizeof(WelcomePacket), 0);
-        if (bytes > 0 && welcome.type == JOIN) {
-            my_id = welcome.assigned_id;
-            identity_received = true;
-            std::cout << "I am Player ID: " << (int)my_id << "\n";
+        if (!network.tx.flush(sock)) { // Whatever of the join the socket didn't take at first
+            std::cerr << "Connection error while joining: " << strerror(errno) << "\n";
+            return 1;
         }
-        else if (bytes == 0) {
-            std::cout << "Server full.\n";
+        int bytes = rx.recv_from(sock);
+        if (bytes == 0) {
+            std::cout << "Server (or the requested room) is full.\n";
             return 0;
         }
         else if (bytes < 0) {
             if (errno != EWOULDBLOCK && errno != EAGAIN) {
                 std::cerr << "Connection error while waiting for ID: " << "\n";
                 return 1;
-        // Optional: add a small usleep(1000) here to save CPU while waiting
-        usleep(1000);
             }
+            usleep(1000); // Nothing yet - don't spin the CPU while waiting
+            continue;
+        }
+        // Only look at the first frame; any snapshots behind it stay buffered for the network thread
+        WelcomePacket welcome;
+        if (rx.next_frame(header, payload) == StreamBuffer::FRAME && header.type == JOIN && wire::decode(payload, header.length, welcome)) {
+            network.my_id = welcome.assigned_id;
+            if (welcome.tick_rate > 0) network.tick_rate = welcome.tick_rate;
+            network.udp_token = welcome.udp_token;
+            network.my_room = welcome.room;
+            udp_port = welcome.udp_port;
+            identity_received = true;
+            if (network.my_id == SPECTATOR_ID) {
+                std::cout << "Spectating room " << network.my_room;
+            } else {
+                std::cout << "I am Player ID: " << (int)network.my_id << " in room " << network.my_room;
+            }
+            std::cout << " (server ticks at " << network.tick_rate << " Hz)\n";
+        }
+    }
+    const uint16_t my_id = network.my_id;
+    const bool spectating = my_id == SPECTATOR_ID; // Everyone is drawn as an opponent, nothing is sent but acks
+    network.spectating = spectating;
+    const float tick_interval = 1.0f / network.tick_rate;
+
+    // Optional UDP transport: connect() a datagram socket to our room's UDP port so recv() only sees the server
+    int udp_sock = -1;
+    if (want_udp && network.udp_token == 0) {
+        std::cout << "Server doesn't offer UDP, staying on TCP\n";
+    } else if (want_udp) {
+        serv_addr.sin_port = htons(udp_port);
+        udp_sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (udp_sock < 0 || connect(udp_sock, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+            std::cerr << "UDP socket error, staying on TCP\n";
+            if (udp_sock >= 0) close(udp_sock);
+            udp_sock = -1;
+        } else {
+            std::cout << "Using UDP transport\n";
         }
     }
 
@@ -77,40 +200,66 @@ int main(int argc, char* argv[]) {
     InitWindow(screenWidth, screenHeight, "Smack.io - Client");
     SetTargetFPS(60);
 
-    // Initialize an empty game state
-    GameStatePacket gameState = {};
-    // uint8_t my_id = 0; // We will just assume we are ID 0 for this demo's simplicity
+    // From here on only the network thread touches the sockets
+    network.udp_sock = udp_sock;
+    std::thread network_thread(&ClientNetwork::run, &network);
 
-    Texture2D playerTex = LoadTexture("assets/player.png");
-    Texture2D paperTex = LoadTexture("assets/newspaper.png");
-    Texture2D opponentTex = LoadTexture("assets/other players.png");
+    // Snapshots picked up from the network thread, kept as the interpolation buffer for remote players.
+    // A frame slower than a tick skips some; interpolation simply blends across the gap.
+    SnapshotRing snapshots;
+    uint32_t last_snapshot = 0;
+    std::vector<PlayerState> view; // What gets drawn this frame: interpolated remote players + predicted us
+
+    SpriteAtlas atlas;
+    atlas.load("assets/player.png", "assets/other players.png", "assets/newspaper.png");
+    RenderTexture2D background = render_static_layer(screenWidth, screenHeight);
+    ScoreLabels score_labels;
+    std::vector<size_t> visible; // Indices into view drawn this frame, for the label pass
+    int winner = -1;             // Id of a player at 100 points in the newest snapshot, or -1
+    char win_text[32] = "";
 
     // 3. The Game Loop
     while (!WindowShouldClose()) {
-        // --- A. CAPTURE INPUT ---
-        InputPacket input = {};
-        input.type = INPUT;
-        input.id = my_id;
-        
-        if (IsKeyDown(KEY_W)) input.dy -= 1.0f;
-        if (IsKeyDown(KEY_S)) input.dy += 1.0f;
-        if (IsKeyDown(KEY_A)) input.dx -= 1.0f;
-        if (IsKeyDown(KEY_D)) input.dx += 1.0f;
+        if (network.closed.load(std::memory_order_acquire)) {
+            std::cout << "Server disconnected.\n";
+            break; // Exit game
+        }
+
+        // --- A. PICK UP NETWORK STATE ---
+        // Whatever the network thread published last; never waits for it
+        if (network.views.update()) {
+            const Snapshot& latest = network.views.read_slot().snapshot;
+            if (latest.seq > last_snapshot) {
+                Snapshot& stored = snapshots.insert(latest.seq);
+                stored.server_time = latest.server_time;
+                stored.entities.assign(latest.entities.begin(), latest.entities.end());
+                last_snapshot = stored.seq;
+                winner = -1; // Scores travel unquantized, so no need to dequantize anyone to find it
+                for (size_t i = 0; i < stored.entities.size() && winner < 0; i++) {
+                    if (stored.entities[i].score >= 100) winner = stored.entities[i].id;
+                }
+                if (winner >= 0) snprintf(win_text, sizeof(win_text), "PLAYER %d WINS!", winner);
+            }
+        }
+        const Prediction& prediction = network.views.read_slot().prediction;
+        double now = monotonic_seconds();
+        // How far through the tick covered by our newest input we are, to blend our position across it
+        float blend = (float)((now - prediction.last_input_time) / tick_interval);
+        if (blend < 0.0f) blend = 0.0f;
+        if (blend > 1.0f) blend = 1.0f;
+
+        // --- B. CAPTURE INPUT ---
+        ControlSample controls = {};
+
+        if (IsKeyDown(KEY_W)) controls.dy -= 1.0f;
+        if (IsKeyDown(KEY_S)) controls.dy += 1.0f;
+        if (IsKeyDown(KEY_A)) controls.dx -= 1.0f;
+        if (IsKeyDown(KEY_D)) controls.dx += 1.0f;
 
         // Check for Restart Request
         if (IsKeyPressed(KEY_R)) {
-            // Check if anyone has won (score >= 10)
-            bool gameEnded = false;
-            for(int i=0; i<MAX_PLAYERS; i++) if(gameState.players[i].score >= 100) gameEnded = true;
-
-            if (gameEnded) {
-                // Send a FULL InputPacket, not just a uint8_t
-                InputPacket restartPacket = {};
-                restartPacket.type = RESTART_REQ;
-                restartPacket.id = my_id;
-                
-                send(sock, &restartPacket, sizeof(InputPacket), 0);
-            }
+            // Only once someone has won (score >= 100)
+            if (winner >= 0) controls.restart = true; // Sent by the network thread with the next input
         }
 
         // if a player holds W and D at the same time, they move faster diagonally because 1+1 in vector length is sqrt.2 ​≈ 1.41. The Solution: Normalize the input vector so diagonal movement isn't a "cheat" speed.
@@ -122,125 +271,112 @@ int main(int argc, char* argv[]) {
 
         // if (dir.x != 0 || dir.y != 0) {
         //     float length = sqrt(dir.x * dir.x + dir.y * dir.y);
-        //     input.dx = dir.x / length;
-        //     input.dy = dir.y / length;
+        //     controls.dx = dir.x / length;
+        //     controls.dy = dir.y / length;
         // }
 
         // Calculate Mouse Rotation (atan2 returns angle in radians between two points and the X-axis)
         Vector2 mousePos = GetMousePosition();
-        // Assuming our player is roughly at the center of our view, or we use our last known pos
-        // For perfect accuracy, we use the player's actual X/Y from the last game state
-        float myX = gameState.players[my_id].active ? gameState.players[my_id].x : screenWidth / 2.0f;
-        float myY = gameState.players[my_id].active ? gameState.players[my_id].y : screenHeight / 2.0f;
-        
-        input.rotation = atan2(mousePos.y - myY, mousePos.x - myX); // returns the angle the player should be facing to look directly at the mouse cursor.
-        input.attack = IsMouseButtonDown(MOUSE_BUTTON_LEFT) ? 1 : 0;
-
-        // Send Input to Server
-        send(sock, &input, sizeof(InputPacket), 0);
-
-        // --- B. RECEIVE NETWORK STATE ---
-        // use a while loop to drain the buffer in case multiple packets arrived
-        GameStatePacket tempState;
-        while (true) {
-            int bytes = recv(sock, &tempState, sizeof(GameStatePacket), 0);
-            if (bytes == sizeof(GameStatePacket)) {
-                if (tempState.type == STATE_UPDATE) {
-                    gameState = tempState;
-                }
-            } else if (bytes < 0) {
-                if (errno != EWOULDBLOCK && errno != EAGAIN) {
-                    std::cerr << "Connection error while receiving game state: " << "\n";
-                }
-                break; // No more data to read this frame
-            } else if (bytes == 0) {
-                std::cout << "Server disconnected.\n";
-                return 0; // Exit game
-            } else {
-                // Partial packet received - in a real game, you'd buffer this!
-                break;
-            }
+        // Aim from where we are drawn (our predicted position), not from the last, already stale, snapshot
+        float myX = screenWidth / 2.0f;
+        float myY = screenHeight / 2.0f;
+        if (prediction.predicting) {
+            myX = prediction.previous_x + (prediction.predicted_x - prediction.previous_x) * blend;
+            myY = prediction.previous_y + (prediction.predicted_y - prediction.previous_y) * blend;
         }
 
+        controls.rotation = atan2(mousePos.y - myY, mousePos.x - myX); // returns the angle the player should be facing to look directly at the mouse cursor.
+        controls.attack = IsMouseButtonDown(MOUSE_BUTTON_LEFT) ? 1 : 0;
+
+        // Tell the server which moment we are showing everyone else at, so it can judge our hits there
+        double render_tick = (now - prediction.clock_offset) / tick_interval - INTERPOLATION_TICKS;
+        if (prediction.clock_synced && render_tick >= 1.0) {
+            controls.view_tick = (uint32_t)render_tick;
+            controls.view_fraction = (uint8_t)((render_tick - controls.view_tick) * 256.0);
+        }
+
+        // The network thread sends one input per server tick from the newest controls it has, so the input
+        // rate doesn't depend on our frame rate. If it is a whole ring behind, this frame's sample is dropped.
+        if (!spectating) network.controls.push(controls);
+
         // --- C. RENDER ---
         BeginDrawing();
         ClearBackground(RAYWHITE);
-
-        // --- DRAW BACKGROUND GRID ---
-        int gridSize = 40;
-        for (int i = 0; i < screenWidth; i += gridSize) {
-            DrawLine(i, 0, i, screenHeight, LIGHTGRAY);
-        }
-        for (int i = 0; i < screenHeight; i += gridSize) {
-            DrawLine(0, i, screenWidth, i, LIGHTGRAY);
+        draw_static_layer(background); // Grid and border, drawn once at startup
+
+        // Remote players a little in the past, between two snapshots; ourselves where prediction says
+        interpolate_players(snapshots, render_tick, view);
+        for (size_t i = 0; i < view.size(); i++) {
+            if (view[i].id != my_id || !prediction.predicting) continue;
+            view[i].x = myX;
+            view[i].y = myY;
+            view[i].rotation = controls.rotation; // Our aim is local too
+            view[i].is_attacking = controls.attack;
         }
 
-        // Optional: Draw a border to show the Arena limits
-        DrawRectangleLinesEx((Rectangle){0, 0, 1500, 900}, 5, DARKGRAY);
+        // Draw all active players that can reach the screen. Every sprite comes from the atlas, so this loop
+        // never switches texture and raylib sends it to the GPU as one batch.
+        Rectangle screen = {0.0f, 0.0f, (float)screenWidth, (float)screenHeight};
+        visible.clear();
+        for (size_t i = 0; i < view.size(); i++) {
+            if (!view[i].active) continue;
+            float px = view[i].x;
+            float py = view[i].y;
+
+            // Calculate Newspaper Size based on Score
+            float paperWidth = 50.0f + (view[i].score * 6.0f);
+            float reach = PAPER_HANDLE_OFFSET + paperWidth + PAPER_SPRITE_HEIGHT / 2.0f; // Covers the body too
+            if (!reaches_view(px, py, reach, screen)) continue;
+            visible.push_back(i);
+
+            float rotDegrees = view[i].rotation * (180.0f / PI);
+            // Add an offset if they are attacking
+            if (view[i].is_attacking) {
+                // This makes the paper "swing" forward by 45 degrees when the button is held
+                rotDegrees += 45.0f;
+            }
 
-        // Draw all active players
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (gameState.players[i].active) {
-                float px = gameState.players[i].x;
-                float py = gameState.players[i].y;
-                float rotDegrees = gameState.players[i].rotation * (180.0f / PI);
+            // --- DRAW PLAYER BODY ---
+            // Source is our sprite's rectangle in the atlas. Dest is where and how big to draw it.
+            Rectangle playerSource = (view[i].id == my_id) ? atlas.player : atlas.opponent;
+            Rectangle playerDest = { px, py, PLAYER_SPRITE_SIZE, PLAYER_SPRITE_SIZE };
+            Vector2 playerOrigin = { PLAYER_SPRITE_SIZE / 2.0f, PLAYER_SPRITE_SIZE / 2.0f }; // Center of the dest rect
+            DrawTexturePro(atlas.texture, playerSource, playerDest, playerOrigin, 0.0f, WHITE);
+
+            // Draw the Newspaper (Rectangle attached to the player)
+            Rectangle paperDest = { px, py, paperWidth, PAPER_SPRITE_HEIGHT };
+            // Origin is the "handle" of the newspaper, offset slightly from the body center
+            Vector2 paperOrigin = { -PAPER_HANDLE_OFFSET, PAPER_SPRITE_HEIGHT / 2.0f };
+            DrawTexturePro(atlas.texture, atlas.paper, paperDest, paperOrigin, rotDegrees, WHITE);
+        }
 
-                // Add an offset if they are attacking
-                if (gameState.players[i].is_attacking) {
-                    // This makes the paper "swing" forward by 45 degrees when the button is held
-                    rotDegrees += 45.0f; 
-                }
-                
-                // --- DRAW PLAYER BODY ---
-                // Source is the whole image. Dest is where and how big to draw it.
-                Texture2D tex = (i == my_id) ? playerTex : opponentTex;
-                Rectangle playerSource = { 0.0f, 0.0f, (float)tex.width, (float)tex.height };
-                Rectangle playerDest = { px, py, 100.0f, 100.0f }; // Hardcoded 40x40 size
-                Vector2 playerOrigin = { 50.0f, 50.0f }; // Center of the 40x40 dest rect
-                
-                // Draw the Player (Circle)
-                DrawTexturePro(tex, playerSource, playerDest, playerOrigin, 0.0f, WHITE);
-
-                // Calculate Newspaper Size based on Score
-                float paperWidth = 50.0f + (gameState.players[i].score * 6.0f);
-                float paperHeight = 100.0f;
-
-                // Draw the Newspaper (Rectangle attached to the player)
-                Rectangle paperSource = { 0.0f, 0.0f, (float)paperTex.width, (float)paperTex.height };
-                Rectangle paperDest = { px, py, paperWidth, paperHeight };
-
-                // Origin is the "handle" of the newspaper. We set X to -10 to offset it slightly from the body center
-                Vector2 paperOrigin = { -10.0f, paperHeight / 2.0f }; // Hinge it at the player's center
-                // Vector2 holds an x and a y value which specify the horizontal and vertical pivot
-
-                Color actionTint = WHITE;
-                DrawTexturePro(paperTex, paperSource, paperDest, paperOrigin, rotDegrees, actionTint);
-
-                // Draw Score
-                DrawText(TextFormat("Score: %d", gameState.players[i].score), px - 20, py - 40, 10, DARKGRAY);
-            }
+        // Draw Scores: a second pass, so the font texture doesn't split the sprite batch. Each label is only
+        // re-formatted when that player's score changes.
+        for (size_t k = 0; k < visible.size(); k++) {
+            const PlayerState& p = view[visible[k]];
+            DrawText(score_labels.text(p.id, p.score), (int)p.x - 20, (int)p.y - 40, 10, DARKGRAY);
         }
 
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (gameState.players[i].score >= 100) {
-                // Draw an overlay
-                DrawRectangle(0, 0, screenWidth, screenHeight, Fade(BLACK, 0.8f));
-                const char* winText = TextFormat("PLAYER %d WINS!", i);
-                int textWidth = MeasureText(winText, 40);
-                DrawText(winText, screenWidth/2 - textWidth/2, screenHeight/2 - 20, 40, GOLD);
-                DrawText("Press R to Restart or ESC to Exit", screenWidth/2 - 130, screenHeight/2 + 40, 20, RAYWHITE);
-            }
+        if (winner >= 0) {
+            // Draw an overlay
+            DrawRectangle(0, 0, screenWidth, screenHeight, Fade(BLACK, 0.8f));
+            int textWidth = MeasureText(win_text, 40);
+            DrawText(win_text, screenWidth/2 - textWidth/2, screenHeight/2 - 20, 40, GOLD);
+            DrawText("Press R to Restart or ESC to Exit", screenWidth/2 - 130, screenHeight/2 + 40, 20, RAYWHITE);
         }
 
         DrawFPS(10, 10);
         EndDrawing();
     }
 
-    UnloadTexture(playerTex);
-    UnloadTexture(paperTex);
-    UnloadTexture(opponentTex);
+    network.stop.store(true, std::memory_order_relaxed);
+    network_thread.join();
+
+    atlas.unload();
+    UnloadRenderTexture(background);
 
     // Cleanup
+    if (udp_sock >= 0) close(udp_sock);
     close(sock);
     CloseWindow();
     return 0;
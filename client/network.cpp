@@ -0,0 +1,263 @@
+#include "network.h"
+#include "../common/clock.h"
+#include "../common/movement.h" // The server's movement rules, for predicting our own position
+#include <iostream>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+// epoll tags
+static const uint32_t STREAM_TAG = 0;
+static const uint32_t DATAGRAM_TAG = 1;
+static const uint32_t TIMER_TAG = 2;
+
+void ClientNetwork::run() {
+    tick_interval = 1.0f / tick_rate;
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    // Edge-triggered: every handler reads until EAGAIN. EPOLLOUT fires when a backed-up tx has room again.
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.u32 = STREAM_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &event);
+    if (udp_sock >= 0) {
+        event.events = EPOLLIN | EPOLLET;
+        event.data.u32 = DATAGRAM_TAG;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, udp_sock, &event);
+    }
+
+    // The server applies one input per tick, so we send on its clock. Reading the timerfd says how many
+    // ticks have passed, which is how many inputs we owe if this thread was held up.
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    long interval_ns = 1000000000L / tick_rate;
+    itimerspec spec{};
+    spec.it_interval.tv_sec = interval_ns / 1000000000L;
+    spec.it_interval.tv_nsec = interval_ns % 1000000000L;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(timer_fd, 0, &spec, NULL);
+    event.events = EPOLLIN;
+    event.data.u32 = TIMER_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+
+    const uint64_t max_catchup = (uint64_t)(MAX_CATCHUP_SECONDS * tick_rate) + 1;
+    epoll_event events[3];
+    bool open = receive_stream(monotonic_seconds()); // Snapshots that arrived behind the WelcomePacket
+    publish();
+    while (open && !stop.load(std::memory_order_relaxed)) {
+        int ready = epoll_wait(epoll_fd, events, 3, 100); // The timeout only matters for noticing `stop`
+        double now = monotonic_seconds();
+        bool changed = false;
+        for (int e = 0; e < ready && open; e++) {
+            if (events[e].data.u32 == TIMER_TAG) {
+                uint64_t expirations = 0;
+                if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+                if (expirations > max_catchup) expirations = max_catchup; // After a long hitch, don't flood the server
+                if (spectating) {
+                    open = send_ack(); // One ack covers however many ticks went by
+                    continue;
+                }
+                for (uint64_t k = 0; k < expirations && open; k++) open = send_input(now);
+            } else if (events[e].data.u32 == DATAGRAM_TAG) {
+                receive_datagrams(now);
+            } else {
+                if (events[e].events & EPOLLOUT) open = tx.flush(sock);
+                if (open && (events[e].events & ~EPOLLOUT)) open = receive_stream(now);
+            }
+            changed = true;
+        }
+        if (changed) publish();
+    }
+
+    close(timer_fd);
+    close(epoll_fd);
+    if (!open) closed.store(true, std::memory_order_release);
+}
+
+// Send one input built from the newest controls the render loop gave us, and predict its effect.
+bool ClientNetwork::send_input(double now) {
+    ControlSample sample;
+    bool restart = false;
+    while (controls.pop(sample)) {
+        latest = sample;
+        restart = restart || sample.restart;
+    }
+    if (restart && !tx.send_frame(sock, RESTART_REQ)) return send_failed(); // The frame type says it all
+
+    InputPacket input = {};
+    input.id = my_id;
+    input.seq = ++input_seq;
+    input.ack = last_snapshot;
+    input.dx = latest.dx;
+    input.dy = latest.dy;
+    input.rotation = latest.rotation;
+    input.attack = latest.attack;
+    input.view_tick = latest.view_tick;
+    input.view_fraction = latest.view_fraction;
+
+    // Quantize it the way the wire will, so we predict with exactly what the server is going to apply
+    uint8_t encoded[INPUT_PACKET_SIZE];
+    wire::encode_at<0>(encoded, input);
+    wire::read(encoded, input);
+
+    // Predict: apply it to ourselves now instead of waiting a round trip for the server
+    sent_inputs[input.seq % PREDICTION_BUFFER] = input;
+    prediction.previous_x = prediction.predicted_x;
+    prediction.previous_y = prediction.predicted_y;
+    if (prediction.predicting) move_player(prediction.predicted_x, prediction.predicted_y, input.dx, input.dy, tick_interval);
+    prediction.last_input_time = now;
+    if (udp_sock < 0) return tx.send_frame(sock, INPUT, input) || send_failed();
+
+    // UDP: the new input plus every older one the server hasn't acked yet (up to REDUNDANT_INPUTS),
+    // so a lost datagram is covered by the next one instead of stalling everything behind it
+    recent_inputs[input.seq % REDUNDANT_INPUTS] = input;
+    uint8_t datagram[DATAGRAM_HEADER_SIZE + 1 + INPUT_PACKET_SIZE * REDUNDANT_INPUTS];
+    DatagramHeader dh;
+    dh.token = udp_token;
+    dh.room = my_room;
+    dh.id = my_id;
+    dh.type = INPUT;
+    dh.seq = input.seq;
+    dh.ack = snapshot_acks.latest;
+    dh.ack_bits = snapshot_acks.bits;
+    wire::encode_at<0>(datagram, dh);
+    uint32_t first = input.seq >= REDUNDANT_INPUTS ? input.seq - REDUNDANT_INPUTS + 1 : 1;
+    if (first <= server_acked_input) first = server_acked_input + 1;
+    uint8_t count = 0;
+    for (uint32_t seq = first; seq <= input.seq; seq++) {
+        wire::encode(datagram + DATAGRAM_HEADER_SIZE + 1 + count * INPUT_PACKET_SIZE, recent_inputs[seq % REDUNDANT_INPUTS]);
+        count++;
+    }
+    datagram[DATAGRAM_HEADER_SIZE] = count;
+    send(udp_sock, datagram, DATAGRAM_HEADER_SIZE + 1 + count * INPUT_PACKET_SIZE, 0);
+    return true;
+}
+
+// Spectators: confirm the newest snapshot so the next one can be a delta against it
+bool ClientNetwork::send_ack() {
+    ControlSample sample;
+    while (controls.pop(sample)) {} // Nothing to steer
+    if (last_snapshot == acked_snapshot) return true;
+    AckPacket ack;
+    ack.ack = last_snapshot;
+    acked_snapshot = last_snapshot;
+    return tx.send_frame(sock, ACK, ack) || send_failed();
+}
+
+bool ClientNetwork::send_failed() {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) std::cerr << "Server stopped reading our inputs\n";
+    else std::cerr << "Connection error while sending: " << strerror(errno) << "\n";
+    return false;
+}
+
+// Drain the TCP stream. Each recv() takes everything the kernel has; we then walk the complete frames in
+// place and only decode the newest snapshot of each batch.
+bool ClientNetwork::receive_stream(double now) {
+    FrameHeader header;
+    const uint8_t* payload = NULL;
+    while (true) {
+        // Into rx: stays put through NEED_MORE, until the recv_from() below
+        const uint8_t* latest_state = NULL;
+        uint32_t latest_length = 0;
+        StreamBuffer::Result result;
+        while ((result = rx.next_frame(header, payload)) == StreamBuffer::FRAME) {
+            if (header.type == STATE_UPDATE && header.length >= GAME_STATE_HEADER_SIZE) {
+                latest_state = payload; // Older snapshots in this batch are already stale
+                latest_length = header.length;
+            }
+        }
+        if (result == StreamBuffer::BAD_FRAME) {
+            std::cerr << "Server sent an oversized frame (" << header.length << " bytes)\n";
+            return false;
+        }
+        if (latest_state) apply_snapshot(latest_state, latest_length, now);
+
+        ssize_t bytes = rx.recv_from(sock);
+        if (bytes == 0) return false;
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EWOULDBLOCK || errno == EAGAIN) return true; // Drained
+            std::cerr << "Connection error while receiving game state: " << strerror(errno) << "\n";
+            return false;
+        }
+    }
+}
+
+// UDP snapshots: each datagram stands alone, so a lost one never holds up the next
+void ClientNetwork::receive_datagrams(double now) {
+    static uint8_t datagram[DATAGRAM_HEADER_SIZE + MAX_SNAPSHOT_DATAGRAM];
+    while (true) {
+        ssize_t n = recv(udp_sock, datagram, sizeof(datagram), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) break; // EAGAIN (or ICMP errors, which we just ride out)
+        if (n < (ssize_t)DATAGRAM_HEADER_SIZE) continue;
+        DatagramHeader dh;
+        wire::read(datagram, dh);
+        if (dh.token != udp_token || dh.type != STATE_UPDATE) continue;
+        if (dh.ack > server_acked_input && dh.ack <= input_seq) server_acked_input = dh.ack;
+        apply_snapshot(datagram + DATAGRAM_HEADER_SIZE, (uint32_t)(n - DATAGRAM_HEADER_SIZE), now);
+    }
+}
+
+// Decode a STATE_UPDATE payload (from either transport), then reconcile our prediction with it
+void ClientNetwork::apply_snapshot(const uint8_t* payload, uint32_t length, double now) {
+    GameStatePacket packet;
+    if (!wire::decode(payload, length, packet)) return;
+    if (packet.seq <= last_snapshot) return; // Datagrams can arrive late or reordered
+    if (!decode_snapshot(payload, length, snapshots, decoded)) return;
+    Snapshot& stored = snapshots.insert(decoded.seq);
+    stored.server_time = decoded.server_time;
+    stored.entities.swap(decoded.entities);
+    last_snapshot = stored.seq;
+    snapshot_acks.received(stored.seq);
+
+    double offset = now - stored.seq * (double)tick_interval;
+    if (!prediction.clock_synced || fabs(offset - prediction.clock_offset) > CLOCK_RESYNC_SECONDS) {
+        prediction.clock_offset = offset;
+        prediction.clock_synced = true;
+    } else {
+        prediction.clock_offset += (offset - prediction.clock_offset) * 0.05; // Ride out jitter, follow drift
+    }
+
+    // Reconcile: start from where the server says we are and replay every input it hasn't applied yet
+    for (size_t i = 0; i < stored.entities.size(); i++) {
+        if (stored.entities[i].id != my_id) continue;
+        PlayerState me = dequantize(stored.entities[i]);
+        float x = me.x, y = me.y;
+        float previous_x = x, previous_y = y;
+        uint32_t first = packet.last_input + 1;
+        if (input_seq >= PREDICTION_BUFFER && first <= input_seq - PREDICTION_BUFFER) first = input_seq - PREDICTION_BUFFER + 1;
+        for (uint32_t seq = first; seq <= input_seq; seq++) {
+            const InputPacket& replay = sent_inputs[seq % PREDICTION_BUFFER];
+            previous_x = x;
+            previous_y = y;
+            move_player(x, y, replay.dx, replay.dy, tick_interval);
+        }
+        prediction.predicted_x = x;
+        prediction.predicted_y = y;
+        prediction.previous_x = previous_x;
+        prediction.previous_y = previous_y;
+        prediction.predicting = true;
+        break;
+    }
+}
+
+// Hand the newest snapshot and prediction to the render loop. The slot being filled holds an old value
+// whose entity storage is reused, so this stops allocating once it has seen the largest snapshot.
+void ClientNetwork::publish() {
+    NetView& view = views.write_slot();
+    const Snapshot* newest = snapshots.find(last_snapshot);
+    if (newest) {
+        view.snapshot.seq = newest->seq;
+        view.snapshot.server_time = newest->server_time;
+        view.snapshot.entities.assign(newest->entities.begin(), newest->entities.end());
+    } else {
+        view.snapshot.seq = 0;
+        view.snapshot.entities.clear();
+    }
+    view.prediction = prediction;
+    views.publish();
+}
@@ -0,0 +1,108 @@
+#ifndef CLIENT_NETWORK_H // Include guard to prevent multiple inclusions
+#define CLIENT_NETWORK_H
+
+#include <stdint.h>
+#include <atomic>
+#include "../common/protocol.h"
+#include "../common/stream_buffer.h"
+#include "../common/snapshot.h"
+#include "../common/ack_tracker.h"
+#include "../common/spsc_ring.h"
+#include "../common/triple_buffer.h"
+
+// --- Client network thread ---
+//
+// The network thread owns the sockets and runs on its own tick clock (a timerfd at the server's tick rate),
+// so inputs go out at a steady rate whatever the render loop is doing - a slow GPU frame no longer delays
+// them, and a fast one no longer has to poll. It talks to the render loop through two lock-free handoffs:
+//   render -> network: an SPSC ring of ControlSamples (what the player is pressing and aiming at, once per
+//                      frame); each tick sends one InputPacket built from the newest sample
+//   network -> render: a triple-buffered NetView (the newest snapshot plus our predicted position), which
+//                      the render loop picks up once per frame, skipping any it was too slow to see
+// Prediction and reconciliation run here too, since they step with the inputs this thread sends.
+// A spectator sends no inputs: each tick it just acks the newest snapshot, if there is a new one.
+
+static const int PREDICTION_BUFFER = 64;         // Sent inputs kept for replay (~1 s at 60 Hz)
+static const double CLOCK_RESYNC_SECONDS = 0.25; // Snap the server clock estimate if it is off by more than this
+static const double MAX_CATCHUP_SECONDS = 0.25;  // After a long stall, send at most this much input at once
+static const size_t CONTROL_RING_SIZE = 64;      // Frames of controls the network thread can fall behind by
+
+// What the player is doing, sampled by the render loop once per frame.
+struct ControlSample {
+    float dx;
+    float dy;
+    float rotation;
+    uint8_t attack;
+    uint32_t view_tick;    // InputPacket.view_tick/view_fraction: the server tick remote players are drawn at
+    uint8_t view_fraction;
+    bool restart;          // R was pressed after a victory
+};
+
+// Our own position as predicted from the inputs sent so far, and the server clock estimate.
+struct Prediction {
+    // predicted_x/y is where we are after every input sent so far; previous_x/y is one input earlier, so
+    // drawing can blend between them over the tick that started at last_input_time
+    bool predicting = false; // Set once a snapshot has told us where we are
+    float predicted_x = 0.0f, predicted_y = 0.0f;
+    float previous_x = 0.0f, previous_y = 0.0f;
+    double last_input_time = 0.0; // monotonic_seconds()
+    // Local time minus server time (seq * tick interval), smoothed, for placing render time on the server's clock
+    double clock_offset = 0.0;
+    bool clock_synced = false;
+};
+
+// Everything the render loop needs from the network, published as one consistent value.
+struct NetView {
+    Snapshot snapshot; // Newest decoded snapshot (seq 0 = none yet)
+    Prediction prediction;
+};
+
+struct ClientNetwork {
+    // Set up by main() after the handshake, before run() starts on its own thread
+    int sock = -1;
+    int udp_sock = -1; // -1 = TCP only
+    uint16_t my_id = 0;       // SPECTATOR_ID when only watching
+    uint16_t my_room = 0;
+    uint32_t udp_token = 0;
+    bool spectating = false;
+    int tick_rate = DEFAULT_TICK_RATE;
+    // Everything from the server arrives as frames on this buffer. Snapshots grow with the player count,
+    // so the buffer may grow up to the largest snapshot a full server could send.
+    StreamBuffer rx{64 * 1024, GAME_STATE_HEADER_SIZE + sizeof(EntityState) * MAX_PLAYERS_LIMIT};
+    // Inputs and acks the socket didn't take yet. 16 KB is seconds of inputs: a server that reads none of
+    // them for that long is gone.
+    SendBuffer tx{16 * 1024};
+
+    SpscRing<ControlSample, CONTROL_RING_SIZE> controls; // Render loop -> network thread
+    TripleBuffer<NetView> views;                         // Network thread -> render loop
+    std::atomic<bool> stop{false};   // Set by the render loop on exit
+    std::atomic<bool> closed{false}; // Set by the network thread when the server goes away
+
+    void run(); // Thread body; returns once `stop` or `closed` is set
+
+private:
+    float tick_interval = 0.0f;
+    ControlSample latest = {}; // Newest sample from the render loop, reused if it stops sending any
+
+    SnapshotRing snapshots; // Delta baselines
+    Snapshot decoded;
+    uint32_t last_snapshot = 0; // Acked back to the server in every InputPacket
+    uint32_t acked_snapshot = 0; // Spectators: last_snapshot as of the last AckPacket sent
+    AckTracker snapshot_acks;   // UDP: which recent snapshots arrived, sent back in every datagram
+
+    uint32_t input_seq = 0;
+    uint32_t server_acked_input = 0;             // UDP: newest input seq the server confirmed
+    InputPacket recent_inputs[REDUNDANT_INPUTS]; // UDP: resent until the server acks them, indexed by seq
+    InputPacket sent_inputs[PREDICTION_BUFFER];  // For reconciliation, indexed by seq
+    Prediction prediction; // Copied into the triple buffer with the newest snapshot on publish
+
+    bool send_input(double now); // Both false once the connection can't take any more
+    bool send_ack();
+    bool send_failed(); // Says why the last send failed; always false
+    bool receive_stream(double now); // false once the server has closed the connection
+    void receive_datagrams(double now);
+    void apply_snapshot(const uint8_t* payload, uint32_t length, double now);
+    void publish();
+};
+
+#endif // CLIENT_NETWORK_H
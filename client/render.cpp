@@ -0,0 +1,67 @@
+#include "render.h"
+#include <stdio.h>
+
+static const int ATLAS_PADDING = 2; // Transparent gap between sprites so filtering never bleeds across
+
+void SpriteAtlas::load(const char* player_path, const char* opponent_path, const char* paper_path) {
+    Image images[3] = {LoadImage(player_path), LoadImage(opponent_path), LoadImage(paper_path)};
+    int width = 0, height = 0;
+    for (int k = 0; k < 3; k++) {
+        width += images[k].width + ATLAS_PADDING;
+        if (images[k].height > height) height = images[k].height;
+    }
+
+    Image atlas = GenImageColor(width > 0 ? width : 1, height > 0 ? height : 1, BLANK);
+    Rectangle* slots[3] = {&player, &opponent, &paper};
+    float x = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        Rectangle source = {0.0f, 0.0f, (float)images[k].width, (float)images[k].height};
+        Rectangle dest = {x, 0.0f, source.width, source.height};
+        if (images[k].data) ImageDraw(&atlas, images[k], source, dest, WHITE);
+        *slots[k] = dest;
+        x += source.width + ATLAS_PADDING;
+        UnloadImage(images[k]);
+    }
+    texture = LoadTextureFromImage(atlas);
+    UnloadImage(atlas);
+}
+
+void SpriteAtlas::unload() {
+    UnloadTexture(texture);
+}
+
+const char* ScoreLabels::text(uint16_t id, uint32_t score) {
+    if (id >= labels.size()) labels.resize((size_t)id + 1);
+    Label& label = labels[id];
+    if (!label.valid || label.score != score) {
+        snprintf(label.text, sizeof(label.text), "Score: %u", score);
+        label.score = score;
+        label.valid = true;
+    }
+    return label.text;
+}
+
+RenderTexture2D render_static_layer(int width, int height) {
+    RenderTexture2D layer = LoadRenderTexture(width, height);
+    BeginTextureMode(layer);
+    ClearBackground(RAYWHITE);
+
+    // --- DRAW BACKGROUND GRID ---
+    int gridSize = 40;
+    for (int i = 0; i < width; i += gridSize) {
+        DrawLine(i, 0, i, height, LIGHTGRAY);
+    }
+    for (int i = 0; i < height; i += gridSize) {
+        DrawLine(0, i, width, i, LIGHTGRAY);
+    }
+
+    // Draw a border to show the Arena limits
+    DrawRectangleLinesEx((Rectangle){0, 0, (float)width, (float)height}, 5, DARKGRAY);
+    EndTextureMode();
+    return layer;
+}
+
+void draw_static_layer(const RenderTexture2D& layer) {
+    Rectangle source = {0.0f, 0.0f, (float)layer.texture.width, -(float)layer.texture.height}; // Flip back
+    DrawTextureRec(layer.texture, source, (Vector2){0.0f, 0.0f}, WHITE);
+}
@@ -0,0 +1,57 @@
+#ifndef CLIENT_RENDER_H // Include guard to prevent multiple inclusions
+#define CLIENT_RENDER_H
+
+#include <stdint.h>
+#include <vector>
+#include "raylib.h"
+
+// --- Rendering helpers ---
+//
+// raylib collects draw calls into a batch and only sends it to the GPU when the batch fills up or the
+// texture changes. So the frame is drawn in three layers that each stay on one texture:
+//   1. the static background (grid and arena border), rendered once into a RenderTexture2D
+//   2. every player and newspaper, all taken from one sprite atlas, so they go out as one batch
+//   3. the score labels (the font texture), only re-formatted when a score changes
+// Players whose sprites can't reach the visible area are skipped before any of that.
+
+static const float PLAYER_SPRITE_SIZE = 100.0f; // Player sprites are drawn as 100x100 squares, centred
+static const float PAPER_SPRITE_HEIGHT = 100.0f;
+static const float PAPER_HANDLE_OFFSET = 10.0f; // The newspaper starts this far from the player's centre
+
+// Player, opponent and newspaper sprites packed side by side into one texture.
+struct SpriteAtlas {
+    Texture2D texture = {};
+    Rectangle player = {};   // Source rectangles inside texture
+    Rectangle opponent = {};
+    Rectangle paper = {};
+
+    // Needs a window (GL context). Missing images just leave their rectangle empty.
+    void load(const char* player_path, const char* opponent_path, const char* paper_path);
+    void unload();
+};
+
+// "Score: N" strings per player id, rebuilt only when that player's score changes.
+struct ScoreLabels {
+    struct Label {
+        uint32_t score = 0;
+        bool valid = false;
+        char text[24];
+    };
+    std::vector<Label> labels; // Indexed by player id, grown on demand
+
+    const char* text(uint16_t id, uint32_t score);
+};
+
+// Draw the background grid and arena border once into a texture the size of the screen.
+RenderTexture2D render_static_layer(int width, int height);
+
+// Blit a layer made by render_static_layer() (render textures are stored upside down).
+void draw_static_layer(const RenderTexture2D& layer);
+
+// Whether anything drawn within `reach` pixels of (x, y) can land inside `view`.
+static inline bool reaches_view(float x, float y, float reach, const Rectangle& view) {
+    return x + reach >= view.x && x - reach <= view.x + view.width &&
+           y + reach >= view.y && y - reach <= view.y + view.height;
+}
+
+#endif // CLIENT_RENDER_H
@@ -0,0 +1,31 @@
+#ifndef ACK_TRACKER_H // Include guard to prevent multiple inclusions
+#define ACK_TRACKER_H
+
+#include <stdint.h>
+
+// Remembers which of the peer's recent sequence numbers arrived, in the form DatagramHeader carries:
+// the newest one plus a 32-bit window of the ones before it. Sending this in every datagram means a
+// single lost ack never matters - the next datagram repeats it.
+struct AckTracker {
+    uint32_t latest = 0; // Newest sequence received (0 = nothing yet)
+    uint32_t bits = 0;   // Bit n = (latest - 1 - n) received
+
+    void received(uint32_t seq) {
+        if (seq == 0) return;
+        if (latest == 0 || seq > latest) {
+            uint32_t shift = latest == 0 ? 33 : seq - latest;
+            bits = shift >= 33 ? 0 : shift == 32 ? (1u << 31) : (bits << shift) | (1u << (shift - 1));
+            latest = seq;
+        } else if (seq < latest && latest - seq <= 32) {
+            bits |= 1u << (latest - seq - 1); // Late (reordered) arrival
+        }
+    }
+
+    bool has(uint32_t seq) const {
+        if (seq == 0 || latest == 0 || seq > latest) return false;
+        if (seq == latest) return true;
+        return latest - seq <= 32 && (bits >> (latest - seq - 1)) & 1u;
+    }
+};
+
+#endif // ACK_TRACKER_H
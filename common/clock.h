@@ -0,0 +1,27 @@
+#ifndef CLOCK_H // Include guard to prevent multiple inclusions
+#define CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+// CLOCK_MONOTONIC in microseconds: never jumps with wall-clock changes, and every process on the same
+// host reads the same clock, so a timestamp from the server can be compared with one taken by a bot.
+static inline uint64_t monotonic_us() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+// The same clock in nanoseconds, for timing the server's own work.
+static inline uint64_t monotonic_ns() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// The same clock in seconds, for timing the client's network thread and frames against each other.
+static inline double monotonic_seconds() {
+    return monotonic_us() / 1000000.0;
+}
+
+#endif // CLOCK_H
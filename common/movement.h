@@ -0,0 +1,28 @@
+#ifndef MOVEMENT_H // Include guard to prevent multiple inclusions
+#define MOVEMENT_H
+
+// --- Movement rules ---
+// Shared by the server's simulation and the client's prediction: as long as both run exactly this code
+// for the same inputs, the client's guess of its own position matches what the server will send back.
+
+static const float MAP_WIDTH = 1500.0f;
+static const float MAP_HEIGHT = 900.0f;
+static const float PLAYER_RADIUS = 50.0f;   // Also the arena margin
+static const float PLAYER_SPEED = 300.0f;   // Pixels per second (5px per input at the old ~60 inputs/s)
+
+// Keep a player's whole body inside the arena.
+static inline void clamp_to_arena(float& x, float& y) {
+    if (x < PLAYER_RADIUS) x = PLAYER_RADIUS;
+    if (x > MAP_WIDTH - PLAYER_RADIUS) x = MAP_WIDTH - PLAYER_RADIUS;
+    if (y < PLAYER_RADIUS) y = PLAYER_RADIUS;
+    if (y > MAP_HEIGHT - PLAYER_RADIUS) y = MAP_HEIGHT - PLAYER_RADIUS;
+}
+
+// One input's worth of movement (dx, dy in -1..1) over dt seconds, then arena boundary clamping.
+static inline void move_player(float& x, float& y, float dx, float dy, float dt) {
+    x += dx * PLAYER_SPEED * dt;
+    y += dy * PLAYER_SPEED * dt;
+    clamp_to_arena(x, y);
+}
+
+#endif // MOVEMENT_H
@@ -2,34 +2,59 @@
 #define PROTOCOL_H
 
 #include <stdint.h> // For fixed-width integer types
+#include "wire.h"     // Turns the packet schemas below into encoders and decoders
 
-#define MAX_PLAYERS 4
+#define DEFAULT_MAX_PLAYERS 4   // Player cap used when server_app is started without --max-players
+#define MAX_PLAYERS_LIMIT 65535 // Hard ceiling: ids 0..65534 travel as 16 bits, and a snapshot's record count too
 #define SERVER_PORT 8080
+#define DEFAULT_TICK_RATE 60    // Simulation steps per second when server_app is started without --tick-rate
+#define REDUNDANT_INPUTS 4      // UDP: each input datagram repeats up to this many not-yet-acked inputs
+#define MAX_SNAPSHOT_DATAGRAM 16384 // UDP: bigger snapshots go over TCP instead (fragments multiply loss)
+#define ANY_ROOM 0              // JoinPacket.room: let the server pick the least crowded room
+#define SPECTATOR_ID 0xFFFF     // WelcomePacket.assigned_id of a spectator (never a player id)
 
-// Packet Types (The "Header")
+// Packet Types (carried in every FrameHeader)
 enum PacketType : uint8_t {
     JOIN = 0,
     INPUT = 1,
     STATE_UPDATE = 2,
-    RESTART_REQ = 3
+    RESTART_REQ = 3,
+    SPECTATE = 4, // Like JOIN, but watch without taking a player slot
+    ACK = 5       // Spectator -> server: newest snapshot decoded (players ack inside their InputPackets)
 };
 
-// Ensure no memory padding ruins our binary data
-#pragma pack(push, 1) // compiler directive to pack struct members with 1-byte alignment to avoid padding being sent through the network
+// --- Wire format ---
+// The structs below are the in-memory form of each packet. They are never sent as raw memory: the schema
+// under each one lists its fields in wire order with their wire codec and the protocol version that added
+// them, and wire.h turns that into the encoder and decoder. Fields are only ever appended, with a higher
+// version, so builds that differ by a version can still talk (see wire.h).
+#define PROTOCOL_VERSION 1 // Newest field version this build knows; sent in every JoinPacket
 
-// Client -> Server: What the player is doing
+// Every message on the TCP stream is a FrameHeader followed by `length` payload bytes.
+// TCP doesn't preserve message boundaries, so the receiver uses the length to find where each frame ends.
+struct FrameHeader {
+    uint32_t length;  // Payload bytes after this header
+    PacketType type;  // What the payload is
+};
+
+// Client -> Server: What the player is doing (frame type INPUT)
+// A RESTART_REQ frame has no payload.
 struct InputPacket {
-    uint8_t type;     // Always INPUT (1)
-    uint8_t id;       // Which player is this?
+    uint16_t id;      // Which player is this?
+    uint32_t seq;     // Increments by one per input; the server applies at most one input per tick, in order
+    uint32_t ack;     // Newest snapshot seq this client has decoded; the server diffs against it
     float dx;         // Movement X (-1.0 to 1.0)
     float dy;         // Movement Y (-1.0 to 1.0)
     float rotation;   // Mouse angle for the newspaper
     uint8_t attack;   // 1 if clicking, 0 if not
+    uint32_t view_tick;    // Server tick the client was drawing other players at (0 = unknown, no rewind)...
+    uint8_t view_fraction; // ...plus this many 256ths of a tick (they are interpolated between snapshots)
 };
 
-// A single player's state
+// A single player's state. This is the decoded, full-precision view; on the wire players travel as
+// quantized, delta-compressed records (see snapshot.h).
 struct PlayerState {
-    uint8_t id;
+    uint16_t id;
     uint8_t active;   // 1 if connected, 0 if empty slot
     float x;
     float y;
@@ -38,17 +63,130 @@ struct PlayerState {
     uint8_t is_attacking;
 };
 
-// Server -> Client: The truth of the game world
+// Server -> Client: The truth of the game world (frame type STATE_UPDATE)
+// Variable length: this header is followed by `count` bit-packed player records (see snapshot.h).
 struct GameStatePacket {
-    uint8_t type;     // Always STATE_UPDATE (2)
-    PlayerState players[MAX_PLAYERS];
+    uint32_t seq;      // Snapshot number, increases every tick
+    uint32_t baseline; // Snapshot the records are a delta against, 0 for a full snapshot
+    uint32_t server_time; // Server's CLOCK_MONOTONIC in microseconds (wraps) when the snapshot was taken
+    uint32_t last_input;  // Newest of the receiving client's input seqs this state includes (0 = none yet)
+    uint16_t count;    // Number of player records that follow
 };
 
+// Client -> Server: First frame on every connection (frame type JOIN, or SPECTATE to only watch). Nothing
+// else is sent until the WelcomePacket comes back. A spectator asking for ANY_ROOM gets the busiest room.
+struct JoinPacket {
+    uint16_t room;   // Room number to join (1-based), or ANY_ROOM
+    uint8_t version; // The client's PROTOCOL_VERSION
+};
+
+// Client -> Server: spectators confirm snapshots with this instead of an InputPacket (frame type ACK), so
+// the server can keep sending them deltas.
+struct AckPacket {
+    uint32_t ack; // Newest snapshot seq decoded
+};
+
+// Server -> Client: Reply to JoinPacket (frame type JOIN). If the room is full the server just closes.
+// A spectator gets assigned_id SPECTATOR_ID and no UDP token.
 struct WelcomePacket {
-    PacketType type; // WELCOME
-    uint8_t assigned_id;
+    uint16_t assigned_id; // Player id within the room
+    uint16_t tick_rate; // Server simulation rate in Hz; clients send exactly one InputPacket per tick
+    uint32_t udp_token; // 0 if the server has no UDP transport, else the secret that binds our UDP address
+    uint16_t room;      // Room number we ended up in
+    uint16_t udp_port;  // Where this room's datagrams go (each worker thread has its own UDP socket)
+};
+
+// --- UDP transport ---
+// With --udp, the TCP connection above is still used for the handshake, but inputs and snapshots travel
+// as datagrams on WelcomePacket.udp_port so one lost packet never stalls the ones behind it.
+// Every datagram starts with this header; the rest is the same payload the TCP frame would carry:
+//   client -> server: INPUT, a uint8_t count, then `count` InputPackets (oldest first; the newest plus
+//                     the ones the server hasn't acked yet, up to REDUNDANT_INPUTS)
+//   server -> client: STATE_UPDATE, then the usual GameStatePacket payload
+struct DatagramHeader {
+    uint32_t token;    // From WelcomePacket; identifies (and authenticates) the player
+    uint16_t room;     // Room the player is in
+    uint16_t id;       // Player id the token belongs to
+    PacketType type;   // What the payload is
+    uint32_t seq;      // Sender's sequence: input seq (client) or snapshot seq (server)
+    uint32_t ack;      // Newest sequence received from the peer
+    uint32_t ack_bits; // Bit n set = peer's (ack - 1 - n) was received too
 };
 
-#pragma pack(pop) // restore original packing alignment
+namespace wire {
+
+template <> struct Schema<FrameHeader> : Layout<
+    WIRE_FIELD(FrameHeader, length, U32, 1),
+    WIRE_FIELD(FrameHeader, type, U8, 1)
+> {};
+
+// Stick and aim are quantized: the server only ever sees (and the client only predicts with) these values
+template <> struct Schema<InputPacket> : Layout<
+    WIRE_FIELD(InputPacket, id, U16, 1),
+    WIRE_FIELD(InputPacket, seq, U32, 1),
+    WIRE_FIELD(InputPacket, ack, U32, 1),
+    WIRE_FIELD(InputPacket, dx, Unit8, 1),
+    WIRE_FIELD(InputPacket, dy, Unit8, 1),
+    WIRE_FIELD(InputPacket, rotation, Angle16, 1),
+    WIRE_FIELD(InputPacket, attack, U8, 1),
+    WIRE_FIELD(InputPacket, view_tick, U32, 1),
+    WIRE_FIELD(InputPacket, view_fraction, U8, 1)
+> {};
+
+// The player records start right behind this header, so unlike the other packets it can't take new fields
+// at the end without a new frame type
+template <> struct Schema<GameStatePacket> : Layout<
+    WIRE_FIELD(GameStatePacket, seq, U32, 1),
+    WIRE_FIELD(GameStatePacket, baseline, U32, 1),
+    WIRE_FIELD(GameStatePacket, server_time, U32, 1),
+    WIRE_FIELD(GameStatePacket, last_input, U32, 1),
+    WIRE_FIELD(GameStatePacket, count, U16, 1)
+> {};
+
+template <> struct Schema<JoinPacket> : Layout<
+    WIRE_FIELD(JoinPacket, room, U16, 1),
+    WIRE_FIELD(JoinPacket, version, U8, 1)
+> {};
+
+template <> struct Schema<AckPacket> : Layout<
+    WIRE_FIELD(AckPacket, ack, U32, 1)
+> {};
+
+template <> struct Schema<WelcomePacket> : Layout<
+    WIRE_FIELD(WelcomePacket, assigned_id, U16, 1),
+    WIRE_FIELD(WelcomePacket, tick_rate, U16, 1),
+    WIRE_FIELD(WelcomePacket, udp_token, U32, 1),
+    WIRE_FIELD(WelcomePacket, room, U16, 1),
+    WIRE_FIELD(WelcomePacket, udp_port, U16, 1)
+> {};
+
+template <> struct Schema<DatagramHeader> : Layout<
+    WIRE_FIELD(DatagramHeader, token, U32, 1),
+    WIRE_FIELD(DatagramHeader, room, U16, 1),
+    WIRE_FIELD(DatagramHeader, id, U16, 1),
+    WIRE_FIELD(DatagramHeader, type, U8, 1),
+    WIRE_FIELD(DatagramHeader, seq, U32, 1),
+    WIRE_FIELD(DatagramHeader, ack, U32, 1),
+    WIRE_FIELD(DatagramHeader, ack_bits, U32, 1)
+> {};
+
+} // namespace wire
+
+// Encoded sizes, for sizing buffers and checking lengths
+static const size_t FRAME_HEADER_SIZE = wire::Size<FrameHeader>::value;
+static const size_t INPUT_PACKET_SIZE = wire::Size<InputPacket>::value;
+static const size_t GAME_STATE_HEADER_SIZE = wire::Size<GameStatePacket>::value;
+static const size_t DATAGRAM_HEADER_SIZE = wire::Size<DatagramHeader>::value;
+
+// An input datagram's body is a count byte and then `count` InputPackets, each as long as the sender's build
+// encodes them. They split the rest of the body evenly, which tells us that length. Returns it, or 0 if the
+// body isn't such a batch (no inputs, too many, or a length that doesn't divide).
+inline size_t input_batch_stride(const uint8_t* body, size_t length) {
+    if (length < 1) return 0;
+    uint8_t count = body[0];
+    if (count == 0 || count > REDUNDANT_INPUTS) return 0;
+    size_t stride = (length - 1) / count;
+    return stride * count == length - 1 ? stride : 0;
+}
 
-#endif // PROTOCOL_H
\ No newline at end of file
+#endif // PROTOCOL_H
@@ -0,0 +1,235 @@
+#include "snapshot.h"
+#include <string.h>
+#include <math.h>
+
+// Packs values LSB-first into a byte vector through a 64-bit accumulator.
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out), acc_(0), bits_(0) {}
+
+    void write(uint32_t value, int count) {
+        acc_ |= (uint64_t)(value & (count == 32 ? 0xFFFFFFFFu : ((1u << count) - 1))) << bits_;
+        bits_ += count;
+        while (bits_ >= 8) {
+            out_.push_back((uint8_t)acc_);
+            acc_ >>= 8;
+            bits_ -= 8;
+        }
+    }
+
+    void flush() {
+        if (bits_ > 0) out_.push_back((uint8_t)acc_);
+        acc_ = 0;
+        bits_ = 0;
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t acc_;
+    int bits_;
+};
+
+// Reads what BitWriter wrote. Running past the end sets a sticky error instead of reading garbage.
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t length) : data_(data), length_(length), pos_(0), acc_(0), bits_(0), overrun_(false) {}
+
+    uint32_t read(int count) {
+        while (bits_ < count) {
+            if (pos_ == length_) {
+                overrun_ = true;
+                return 0;
+            }
+            acc_ |= (uint64_t)data_[pos_++] << bits_;
+            bits_ += 8;
+        }
+        uint32_t value = (uint32_t)(acc_ & (count == 32 ? 0xFFFFFFFFull : ((1ull << count) - 1)));
+        acc_ >>= count;
+        bits_ -= count;
+        return value;
+    }
+
+    bool overrun() const { return overrun_; }
+
+private:
+    const uint8_t* data_;
+    size_t length_;
+    size_t pos_;
+    uint64_t acc_;
+    int bits_;
+    bool overrun_;
+};
+
+static uint16_t quantize_position(float value) {
+    float q = roundf((value + POSITION_OFFSET) * POSITION_SCALE);
+    if (q < 0.0f) q = 0.0f;
+    if (q > 65535.0f) q = 65535.0f;
+    return (uint16_t)q;
+}
+
+EntityState quantize(const PlayerState& player) {
+    const float TWO_PI = 6.28318530718f;
+    const float steps = (float)(1 << ROTATION_BITS);
+    float turns = player.rotation / TWO_PI;
+    turns -= floorf(turns); // Wrap into [0, 1)
+
+    EntityState entity;
+    entity.id = player.id;
+    entity.x = quantize_position(player.x);
+    entity.y = quantize_position(player.y);
+    entity.rotation = (uint16_t)((uint32_t)roundf(turns * steps) & ((1u << ROTATION_BITS) - 1));
+    entity.score = player.score;
+    entity.is_attacking = player.is_attacking ? 1 : 0;
+    return entity;
+}
+
+PlayerState dequantize(const EntityState& entity) {
+    const float TWO_PI = 6.28318530718f;
+    PlayerState player;
+    player.id = entity.id;
+    player.active = 1;
+    player.x = entity.x / POSITION_SCALE - POSITION_OFFSET;
+    player.y = entity.y / POSITION_SCALE - POSITION_OFFSET;
+    player.rotation = entity.rotation * (TWO_PI / (1 << ROTATION_BITS));
+    if (player.rotation > TWO_PI / 2) player.rotation -= TWO_PI; // Same [-pi, pi] range atan2() gives
+    player.score = entity.score;
+    player.is_attacking = entity.is_attacking;
+    return player;
+}
+
+// Writes one record. `base` is the entity's baseline state, or NULL if the client doesn't have it yet.
+static void write_record(BitWriter& bits, uint32_t& prev_id, const EntityState& entity, const EntityState* base) {
+    bool next_id = (uint32_t)entity.id == prev_id + 1;
+    bits.write(next_id, 1);
+    if (!next_id) bits.write(entity.id, 16);
+    prev_id = entity.id;
+    bits.write(0, 1); // not removed
+
+    bool pos_changed = !base || base->x != entity.x || base->y != entity.y;
+    bits.write(pos_changed, 1);
+    if (pos_changed) {
+        bits.write(entity.x, 16);
+        bits.write(entity.y, 16);
+    }
+
+    bool rot_changed = !base || base->rotation != entity.rotation;
+    bits.write(rot_changed, 1);
+    if (rot_changed) bits.write(entity.rotation, ROTATION_BITS);
+
+    bool score_changed = !base || base->score != entity.score;
+    bits.write(score_changed, 1);
+    if (score_changed) {
+        bool small = entity.score < 128;
+        bits.write(small, 1);
+        bits.write(entity.score, small ? 7 : 32);
+    }
+
+    bits.write(entity.is_attacking, 1);
+}
+
+static void write_removal(BitWriter& bits, uint32_t& prev_id, uint16_t id) {
+    bool next_id = (uint32_t)id == prev_id + 1;
+    bits.write(next_id, 1);
+    if (!next_id) bits.write(id, 16);
+    prev_id = id;
+    bits.write(1, 1); // removed
+}
+
+static bool same_state(const EntityState& a, const EntityState& b) {
+    return a.x == b.x && a.y == b.y && a.rotation == b.rotation && a.score == b.score && a.is_attacking == b.is_attacking;
+}
+
+static_assert(MAX_PLAYERS_LIMIT <= 0xFFFF, "one record per player id must fit GameStatePacket.count");
+
+void encode_snapshot(const Snapshot& current, const Snapshot* baseline, std::vector<uint8_t>& out) {
+    size_t header_pos = out.size();
+    out.resize(header_pos + GAME_STATE_HEADER_SIZE); // Filled in once we know the record count
+
+    GameStatePacket header;
+    header.seq = current.seq;
+    header.baseline = baseline ? baseline->seq : 0;
+    header.server_time = current.server_time;
+    header.last_input = 0; // Per client: the server fills it in on the way out
+    header.count = 0;
+
+    BitWriter bits(out);
+    uint32_t prev_id = 0xFFFFFFFFu; // So that id 0 codes as "previous + 1"
+
+    // Both lists are sorted by id, so one merge pass finds added, changed and removed entities.
+    static const std::vector<EntityState> empty;
+    const std::vector<EntityState>& base = baseline ? baseline->entities : empty;
+    size_t b = 0;
+    for (size_t c = 0; c < current.entities.size(); c++) {
+        const EntityState& entity = current.entities[c];
+        while (b < base.size() && base[b].id < entity.id) {
+            write_removal(bits, prev_id, base[b].id);
+            header.count++;
+            b++;
+        }
+        const EntityState* previous = NULL;
+        if (b < base.size() && base[b].id == entity.id) previous = &base[b++];
+        if (previous && same_state(*previous, entity)) continue; // Unchanged: the client already has it
+        write_record(bits, prev_id, entity, previous);
+        header.count++;
+    }
+    for (; b < base.size(); b++) {
+        write_removal(bits, prev_id, base[b].id);
+        header.count++;
+    }
+    bits.flush();
+
+    wire::encode(out.data() + header_pos, header);
+}
+
+bool decode_snapshot(const uint8_t* payload, size_t length, const SnapshotRing& history, Snapshot& out) {
+    if (length < GAME_STATE_HEADER_SIZE) return false;
+    GameStatePacket header;
+    wire::read(payload, header);
+
+    static const std::vector<EntityState> empty;
+    const std::vector<EntityState>* base = &empty;
+    if (header.baseline != 0) {
+        const Snapshot* baseline = history.find(header.baseline);
+        if (!baseline) return false; // We no longer have what the server diffed against
+        base = &baseline->entities;
+    }
+
+    BitReader bits(payload + GAME_STATE_HEADER_SIZE, length - GAME_STATE_HEADER_SIZE);
+    out.seq = header.seq;
+    out.server_time = header.server_time;
+    out.entities.clear();
+
+    uint32_t prev_id = 0xFFFFFFFFu;
+    size_t b = 0;
+    for (uint32_t r = 0; r < header.count; r++) {
+        uint32_t id = bits.read(1) ? prev_id + 1 : bits.read(16);
+        if (bits.overrun() || id > 0xFFFF || (prev_id != 0xFFFFFFFFu && id <= prev_id)) return false;
+        prev_id = id;
+
+        // Baseline entities before this id are unchanged: carry them over
+        while (b < base->size() && (*base)[b].id < id) out.entities.push_back((*base)[b++]);
+        const EntityState* previous = NULL;
+        if (b < base->size() && (*base)[b].id == id) previous = &(*base)[b++];
+
+        if (bits.read(1)) continue; // Removed: simply don't carry it over
+
+        EntityState entity;
+        if (previous) {
+            entity = *previous;
+        } else {
+            memset(&entity, 0, sizeof(entity));
+        }
+        entity.id = (uint16_t)id;
+        if (bits.read(1)) {
+            entity.x = (uint16_t)bits.read(16);
+            entity.y = (uint16_t)bits.read(16);
+        }
+        if (bits.read(1)) entity.rotation = (uint16_t)bits.read(ROTATION_BITS);
+        if (bits.read(1)) entity.score = bits.read(bits.read(1) ? 7 : 32);
+        entity.is_attacking = (uint8_t)bits.read(1);
+        if (bits.overrun()) return false;
+        out.entities.push_back(entity);
+    }
+    while (b < base->size()) out.entities.push_back((*base)[b++]);
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef SNAPSHOT_H // Include guard to prevent multiple inclusions
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "protocol.h"
+
+// --- Snapshot delta compression ---
+//
+// Instead of sending every PlayerState as raw floats every tick, the server sends each client only what
+// changed since a snapshot that client has acknowledged (its "baseline"). Values are quantized to
+// fixed-point and written with a bit writer, so a player standing still costs nothing and a moving one
+// costs a few bytes. A baseline of 0 means "full snapshot" (used on join, or when the client's ack is
+// too old for the server to still have that snapshot).
+//
+// STATE_UPDATE payload = GameStatePacket header + `count` bit-packed records, sorted by id. Each id gets at
+// most one record, live or removed, and ids stay below MAX_PLAYERS_LIMIT, so even a delta that adds and
+// removes every slot it can (65535 records) fits the 16-bit count:
+//   1 bit   id is previous id + 1 (else 16-bit id follows)
+//   1 bit   removed (entity was in the baseline but is gone now - nothing else follows)
+//   1 bit   position changed  -> 16-bit x, 16-bit y
+//   1 bit   rotation changed  -> ROTATION_BITS angle
+//   1 bit   score changed     -> 1 bit "small" + 7 bits, or 32 bits
+//   1 bit   is_attacking
+
+static const int SNAPSHOT_HISTORY = 32;      // Snapshots kept on both ends to serve as delta baselines
+static const float POSITION_SCALE = 8.0f;    // 1/8 pixel precision
+static const float POSITION_OFFSET = 2048.0f; // Quantized range covers [-2048, 6144) pixels
+static const int ROTATION_BITS = 12;         // ~0.09 degree steps
+
+// One player in quantized form. This is what snapshots store and compare; it round-trips exactly.
+struct EntityState {
+    uint16_t id;
+    uint16_t x;
+    uint16_t y;
+    uint16_t rotation;
+    uint32_t score;
+    uint8_t is_attacking;
+};
+
+struct Snapshot {
+    uint32_t seq = 0;                  // 0 = empty slot
+    uint32_t server_time = 0;          // GameStatePacket.server_time
+    std::vector<EntityState> entities; // Sorted by id
+};
+
+// Fixed ring of recent snapshots, looked up by sequence number.
+struct SnapshotRing {
+    Snapshot slots[SNAPSHOT_HISTORY];
+
+    const Snapshot* find(uint32_t seq) const {
+        if (seq == 0) return NULL;
+        const Snapshot& s = slots[seq % SNAPSHOT_HISTORY];
+        return s.seq == seq ? &s : NULL;
+    }
+
+    // Returns the slot for seq, evicting whatever was there. Entity storage is reused, not reallocated.
+    Snapshot& insert(uint32_t seq) {
+        Snapshot& s = slots[seq % SNAPSHOT_HISTORY];
+        s.seq = seq;
+        s.entities.clear();
+        return s;
+    }
+};
+
+EntityState quantize(const PlayerState& player);
+PlayerState dequantize(const EntityState& entity);
+
+// Append a STATE_UPDATE payload for `current` to `out`. baseline == NULL writes a full snapshot. Entity ids
+// in both must be below MAX_PLAYERS_LIMIT.
+void encode_snapshot(const Snapshot& current, const Snapshot* baseline, std::vector<uint8_t>& out);
+
+// Rebuild a snapshot from a STATE_UPDATE payload, using `history` for the baseline it refers to.
+// Returns false if the payload is malformed or its baseline is no longer in the history.
+bool decode_snapshot(const uint8_t* payload, size_t length, const SnapshotRing& history, Snapshot& out);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,38 @@
+#ifndef SPSC_RING_H // Include guard to prevent multiple inclusions
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <atomic>
+
+// Bounded single-producer, single-consumer queue. The producer only writes `tail` and the consumer only
+// writes `head`, so each side needs one acquire load of the other's index and one release store of its
+// own - no locks, no compare-and-swap, and neither side ever waits for the other.
+// Capacity must be a power of two; indices run freely and are masked on use.
+template <typename T, size_t Capacity>
+struct SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+    T items[Capacity];
+    alignas(64) std::atomic<size_t> head{0}; // Next item to pop (written by the consumer)
+    alignas(64) std::atomic<size_t> tail{0}; // Next free slot (written by the producer)
+
+    // Producer side. Returns false (and drops the item) when the consumer is a full ring behind.
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+        items[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when empty.
+    bool pop(T& out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        out = items[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,167 @@
+#ifndef STREAM_BUFFER_H // Include guard to prevent multiple inclusions
+#define STREAM_BUFFER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "protocol.h"
+
+// Per-connection receive buffer for the framed TCP stream.
+//
+// TCP is a byte stream: one recv() can return half a frame, or ten frames, or the tail of one and the
+// head of the next. We recv() as much as the kernel has into the free space at the end of the buffer,
+// then hand out every complete frame as a pointer straight into the buffer (no copy). Only the
+// unfinished frame at the end is ever moved, and only when it would otherwise run out of room - which
+// recv_from() sorts out before it receives, so the frames handed out since the last recv stay put.
+struct StreamBuffer {
+    enum Result {
+        FRAME,     // header/payload describe a complete frame
+        NEED_MORE, // the next frame hasn't fully arrived yet
+        BAD_FRAME  // the peer announced a frame larger than max_payload - drop the connection
+    };
+
+    std::vector<uint8_t> data;
+    size_t read_pos = 0;  // First byte not yet handed out as a frame
+    size_t write_pos = 0; // One past the last byte received
+    size_t wanted = FRAME_HEADER_SIZE; // Bytes from read_pos the next frame needs, as of the last NEED_MORE
+    uint32_t max_payload; // Largest payload we are willing to buffer for this peer
+
+    StreamBuffer(size_t initial_capacity, uint32_t max_payload_bytes)
+        : data(initial_capacity), max_payload(max_payload_bytes) {}
+
+    void clear() { read_pos = write_pos = 0; wanted = FRAME_HEADER_SIZE; }
+    size_t readable() const { return write_pos - read_pos; }
+    size_t writable() const { return data.size() - write_pos; }
+
+    // One recv() into all the free space we have. Same return convention as recv():
+    // >0 bytes read, 0 on orderly shutdown, -1 on error (check errno for EAGAIN).
+    // Call next_frame() until NEED_MORE before receiving again, so there is always room left. This is the
+    // only place buffered bytes move: every payload pointer next_frame() handed out goes stale here.
+    ssize_t recv_from(int fd) {
+        if (readable() == 0) read_pos = write_pos = 0; // Empty: rewind for free
+        else make_room(wanted);
+        if (writable() == 0) {
+            errno = ENOBUFS; // Caller didn't drain complete frames first
+            return -1;
+        }
+        ssize_t n = recv(fd, data.data() + write_pos, writable(), 0);
+        if (n > 0) write_pos += n;
+        return n;
+    }
+
+    // Parse the next complete frame in place. Never moves buffered bytes, so the payload pointer stays valid
+    // until the next recv_from() - even past a later NEED_MORE.
+    Result next_frame(FrameHeader& header, const uint8_t*& payload) {
+        if (readable() < FRAME_HEADER_SIZE) {
+            wanted = FRAME_HEADER_SIZE;
+            return NEED_MORE;
+        }
+        wire::read(data.data() + read_pos, header);
+        if (header.length > max_payload) return BAD_FRAME;
+
+        size_t frame_size = FRAME_HEADER_SIZE + header.length;
+        if (readable() < frame_size) {
+            wanted = frame_size; // recv_from() makes sure the rest can land behind what we have
+            return NEED_MORE;
+        }
+        payload = data.data() + read_pos + FRAME_HEADER_SIZE;
+        read_pos += frame_size;
+        wanted = FRAME_HEADER_SIZE;
+        return FRAME;
+    }
+
+private:
+    // Make sure a frame of frame_size bytes starting at read_pos fits before the end of the buffer.
+    void make_room(size_t frame_size) {
+        if (read_pos + frame_size <= data.size()) return;
+        size_t pending = readable();
+        if (read_pos > 0) {
+            memmove(data.data(), data.data() + read_pos, pending); // Only the unfinished frame moves
+            read_pos = 0;
+            write_pos = pending;
+        }
+        if (frame_size > data.size()) data.resize(frame_size); // Bounded by max_payload in next_frame()
+    }
+};
+
+// Write a frame header in front of a payload the caller has placed (or will place) right after it.
+inline uint8_t* write_frame_header(uint8_t* dst, PacketType type, uint32_t length) {
+    FrameHeader header;
+    header.length = length;
+    header.type = type;
+    return wire::encode(dst, header);
+}
+
+// A frame with no payload (e.g. RESTART_REQ), in a single syscall.
+inline ssize_t send_frame(int fd, PacketType type) {
+    uint8_t frame[FRAME_HEADER_SIZE];
+    write_frame_header(frame, type, 0);
+    return send(fd, frame, sizeof(frame), MSG_NOSIGNAL);
+}
+
+// Encode header + packet into one buffer of exactly the right size and send it with a single syscall.
+// Small control packets only; snapshots are assembled by the caller.
+template <class Packet>
+inline ssize_t send_frame(int fd, PacketType type, const Packet& packet) {
+    uint8_t frame[FRAME_HEADER_SIZE + wire::Size<Packet>::value];
+    write_frame_header(frame, type, (uint32_t)wire::Size<Packet>::value);
+    wire::encode_at<FRAME_HEADER_SIZE>(frame, packet);
+    return send(fd, frame, sizeof(frame), MSG_NOSIGNAL);
+}
+
+// Outbound side of a connection that only sends small control frames (inputs, acks, joins) on a
+// non-blocking socket. If the kernel takes only part of a frame, the next frame can't just follow with a
+// send() of its own: the peer would read the two spliced together. So whatever the socket didn't take waits
+// here, in order, and goes out ahead of anything newer - on the next send, or from EPOLLOUT via flush().
+// A peer that stops reading for long enough to fill `limit` bytes is treated as gone.
+struct SendBuffer {
+    std::vector<uint8_t> data;
+    size_t sent = 0; // data[0 .. sent) already went out
+    size_t limit;    // Most bytes we are willing to hold for this peer
+
+    explicit SendBuffer(size_t max_bytes) : limit(max_bytes) {}
+
+    bool empty() const { return sent == data.size(); }
+    void clear() { data.clear(); sent = 0; }
+
+    // Queue a frame with no payload (e.g. RESTART_REQ) and send what the socket takes. False means the
+    // connection is unusable: a socket error, or `limit` exceeded.
+    bool send_frame(int fd, PacketType type) {
+        uint8_t* frame = append(FRAME_HEADER_SIZE);
+        write_frame_header(frame, type, 0);
+        return flush(fd);
+    }
+
+    // Same, with `packet` encoded as the payload.
+    template <class Packet>
+    bool send_frame(int fd, PacketType type, const Packet& packet) {
+        uint8_t* frame = append(FRAME_HEADER_SIZE + wire::Size<Packet>::value);
+        wire::encode(write_frame_header(frame, type, (uint32_t)wire::Size<Packet>::value), packet);
+        return flush(fd);
+    }
+
+    // Send queued bytes until done or EAGAIN (call it on EPOLLOUT too). False on a socket error, or when
+    // more than `limit` bytes are still waiting.
+    bool flush(int fd) {
+        while (!empty()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return data.size() - sent <= limit;
+            if (n < 0) return false;
+            sent += (size_t)n;
+        }
+        clear(); // Keeps the capacity, so steady sending doesn't allocate
+        return true;
+    }
+
+private:
+    uint8_t* append(size_t length) {
+        data.resize(data.size() + length);
+        return data.data() + data.size() - length;
+    }
+};
+
+#endif // STREAM_BUFFER_H
@@ -0,0 +1,37 @@
+#ifndef TRIPLE_BUFFER_H // Include guard to prevent multiple inclusions
+#define TRIPLE_BUFFER_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Hands the newest value from one writer thread to one reader thread without locks or waiting.
+// Three slots: the writer owns one ("back"), the reader owns one ("front"), and the third ("middle") is
+// swapped atomically between them. Publishing swaps back with middle and marks it fresh; picking up swaps
+// front with middle if it is fresh. A value the reader didn't pick up in time is simply replaced by the
+// next one, so a slow reader always skips ahead to the latest.
+template <typename T>
+struct TripleBuffer {
+    T slots[3];
+
+    // Writer side: fill every field of write_slot() (it holds an old value), then publish().
+    T& write_slot() { return slots[back]; }
+    void publish() { back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK; }
+
+    // Reader side: update() switches to the newest published value, if there is one since the last call.
+    // read_slot() stays valid and unchanged until the next update().
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T& read_slot() const { return slots[front]; }
+
+private:
+    static const uint8_t FRESH = 4; // Set in `middle` when it holds a value the reader hasn't seen
+    static const uint8_t INDEX_MASK = 3;
+    std::atomic<uint8_t> middle{1};
+    uint8_t back = 0;  // Only touched by the writer
+    uint8_t front = 2; // Only touched by the reader
+};
+
+#endif // TRIPLE_BUFFER_H
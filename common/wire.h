@@ -0,0 +1,200 @@
+#ifndef WIRE_H // Include guard to prevent multiple inclusions
+#define WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+// --- Packet codec ---
+//
+// Packets are plain structs in memory; what goes on the wire is described separately, by a schema listing
+// each field's wire codec and the protocol version that added it (see protocol.h):
+//
+//   template <> struct Schema<AckPacket> : Layout<
+//       WIRE_FIELD(AckPacket, ack, U32, 1)
+//   > {};
+//
+// The templates below turn a schema into straight-line encode/decode code: every field's offset and size
+// is a compile-time constant, so encoding is a run of byte stores into the caller's buffer (socket frame,
+// datagram, snapshot vector) and decoding a run of loads from the receive buffer, with no per-field
+// dispatch. Integers are little-endian whatever the host, and a struct's padding never reaches the wire.
+//
+// Versioning: fields are append-only. Each field is tagged with the version that introduced it, and a
+// field may only follow fields of the same or an older version (checked at compile time). A peer running
+// an older build sends a shorter packet - the decoder fills the fields it didn't send with zero - and one
+// running a newer build sends a longer one, whose tail we skip. Only the version 1 fields are required.
+
+namespace wire {
+
+static const double HALF_TURN = 3.14159265358979323846; // Radians (not PI: raylib defines that as a macro)
+
+// Unsigned integer, little-endian.
+template <class Int>
+struct Uint {
+    typedef Int Value;
+    enum : size_t { size = sizeof(Int) };
+    static void put(uint8_t* out, Int value) {
+        for (size_t k = 0; k < sizeof(Int); k++) out[k] = (uint8_t)(value >> (8 * k));
+    }
+    static Int get(const uint8_t* in) {
+        Int value = 0;
+        for (size_t k = 0; k < sizeof(Int); k++) value = (Int)(value | ((Int)in[k] << (8 * k)));
+        return value;
+    }
+};
+
+typedef Uint<uint8_t> U8;
+typedef Uint<uint16_t> U16;
+typedef Uint<uint32_t> U32;
+
+// IEEE 754 single, sent as its bit pattern.
+struct F32 {
+    typedef float Value;
+    enum : size_t { size = 4 };
+    static void put(uint8_t* out, float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        U32::put(out, bits);
+    }
+    static float get(const uint8_t* in) {
+        uint32_t bits = U32::get(in);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+// A float in -1..1 as one signed byte (127 steps each way, so -1, 0 and 1 round-trip exactly).
+struct Unit8 {
+    typedef float Value;
+    enum : size_t { size = 1 };
+    static void put(uint8_t* out, float value) {
+        if (!(value > -1.0f)) value = -1.0f; // Also catches NaN
+        if (value > 1.0f) value = 1.0f;
+        out[0] = (uint8_t)(int8_t)lrintf(value * 127.0f);
+    }
+    static float get(const uint8_t* in) { return (int8_t)in[0] / 127.0f; }
+};
+
+// An angle in radians as a 16-bit fraction of a turn. Decodes into [-pi, pi).
+struct Angle16 {
+    typedef float Value;
+    enum : size_t { size = 2 };
+    static void put(uint8_t* out, float radians) {
+        float turns = radians * (float)(0.5 / HALF_TURN);
+        turns -= floorf(turns + 0.5f); // Wrap into [-0.5, 0.5)
+        long steps = lrintf(turns * 65536.0f);
+        U16::put(out, (uint16_t)(steps & 0xFFFF)); // +32768 (exactly half a turn) wraps to -32768
+    }
+    static float get(const uint8_t* in) { return (int16_t)U16::get(in) * (float)(HALF_TURN / 32768.0); }
+};
+
+// One struct member with its codec and the protocol version that added it. Use WIRE_FIELD.
+template <class T, class M, M T::*Member, class Codec, int Since>
+struct Field {
+    enum : size_t { size = Codec::size };
+    enum { since = Since };
+    static_assert(Since >= 1, "protocol versions start at 1");
+    static void put(uint8_t* out, const T& packet) { Codec::put(out, (typename Codec::Value)(packet.*Member)); }
+    static void get(const uint8_t* in, T& packet) { packet.*Member = (M)Codec::get(in); }
+    static void clear(T& packet) { packet.*Member = M(); }
+};
+
+#define WIRE_FIELD(Type, member, Codec, since) \
+    ::wire::Field<Type, decltype(Type::member), &Type::member, ::wire::Codec, since>
+
+// A packet's fields, in wire order. Everything here is resolved at compile time; the recursion unrolls
+// into one load or store per field.
+template <class... Fields>
+struct Layout;
+
+template <>
+struct Layout<> {
+    enum : size_t { size = 0, required_size = 0 };
+    enum { version = 1, oldest = 1 << 30 };
+    template <class T> static void put(uint8_t*, const T&) {}
+    template <class T> static void get(const uint8_t*, T&) {}
+    template <class T> static void get_partial(const uint8_t*, size_t, T&) {}
+};
+
+template <class First, class... Rest>
+struct Layout<First, Rest...> {
+    typedef Layout<Rest...> Tail;
+    static_assert((int)First::since <= (int)Tail::oldest, "fields must be appended in version order");
+
+    enum : size_t {
+        size = First::size + Tail::size, // Bytes this build writes
+        // Bytes every peer sends: the version 1 prefix
+        required_size = First::since == 1 ? First::size + Tail::required_size : 0
+    };
+    enum {
+        version = (int)First::since > (int)Tail::version ? (int)First::since : (int)Tail::version,
+        oldest = First::since
+    };
+
+    template <class T> static void put(uint8_t* out, const T& packet) {
+        First::put(out, packet);
+        Tail::put(out + First::size, packet);
+    }
+    template <class T> static void get(const uint8_t* in, T& packet) {
+        First::get(in, packet);
+        Tail::get(in + First::size, packet);
+    }
+    // Only `available` bytes arrived: the fields past the end are zeroed.
+    template <class T> static void get_partial(const uint8_t* in, size_t available, T& packet) {
+        if (available >= First::size) {
+            First::get(in, packet);
+            Tail::get_partial(in + First::size, available - First::size, packet);
+        } else {
+            First::clear(packet);
+            Tail::get_partial(in, 0, packet);
+        }
+    }
+};
+
+// Specialized in protocol.h for every packet type.
+template <class T>
+struct Schema;
+
+// Bytes `packet` takes on the wire.
+template <class T>
+struct Size {
+    enum : size_t { value = Schema<T>::size };
+};
+
+// Write `packet` at `out`, which must have Size<T>::value bytes free. Returns the end of what was written.
+template <class T>
+inline uint8_t* encode(uint8_t* out, const T& packet) {
+    Schema<T>::put(out, packet);
+    return out + Schema<T>::size;
+}
+
+// Same, into a fixed buffer at a fixed offset: a packet that doesn't fit is a compile error.
+template <size_t Offset, class T, size_t N>
+inline uint8_t* encode_at(uint8_t (&out)[N], const T& packet) {
+    static_assert(Offset + Schema<T>::size <= N, "packet doesn't fit in the buffer");
+    return encode(out + Offset, packet);
+}
+
+// Read a packet from `length` received bytes. False if they don't hold even the version 1 fields.
+template <class T>
+inline bool decode(const uint8_t* in, size_t length, T& packet) {
+    if (length >= (size_t)Schema<T>::size) {
+        Schema<T>::get(in, packet); // Common case: same version or newer, no per-field checks
+        return true;
+    }
+    if (length < (size_t)Schema<T>::required_size) return false;
+    Schema<T>::get_partial(in, length, packet);
+    return true;
+}
+
+// Read a packet the caller has already checked arrived whole (Size<T>::value bytes at `in`).
+template <class T>
+inline void read(const uint8_t* in, T& packet) {
+    Schema<T>::get(in, packet);
+}
+
+} // namespace wire
+
+#endif // WIRE_H
@@ -0,0 +1,399 @@
+#include <iostream>
+#include <vector>
+#include <memory> // shared_ptr: one encoded frame, referenced by every viewer it goes to
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h> // for TCP_NODELAY
+#include <sys/epoll.h>
+#include <sys/resource.h> // setrlimit(): one descriptor per viewer
+#include "../common/protocol.h"
+#include "../common/stream_buffer.h"
+#include "../common/snapshot.h"
+#include "../common/clock.h"
+
+// --- Spectator relay ---
+//
+// relay_app takes one spectator connection to server_app and fans every snapshot out to its own viewers,
+// so a match can be watched by thousands of people while the room's worker only ever sends to the relay.
+// Viewers speak the normal protocol (SPECTATE, then ACK frames), so the client's --spectate mode works
+// against a relay exactly as against the server.
+//
+// Each snapshot is decoded once, then encoded once per distinct baseline the viewers have acked (in
+// practice one or two encodings, however many viewers there are) into a refcounted frame that every
+// viewer with that baseline shares - nothing is copied per viewer. A viewer holds at most two frames: the
+// one being written to its socket and the next one. If it falls behind, a newer snapshot replaces the
+// next one, so a slow viewer skips ahead instead of queueing up stale state.
+
+static const int RELAY_PORT = 8081; // Where viewers connect, unless --port says otherwise
+static const int DEFAULT_MAX_VIEWERS = 1024;
+static const int VIEWER_SEND_BUFFER = 64 * 1024; // SO_SNDBUF per viewer: keeps the backlog here, where it can be skipped
+static const double REPORT_SECONDS = 10.0;
+
+// epoll tags: viewers use their index
+static const uint32_t LISTEN_TAG = 0xFFFFFFFFu;
+static const uint32_t UPSTREAM_TAG = 0xFFFFFFFEu;
+
+typedef std::shared_ptr<const std::vector<uint8_t> > Frame; // FrameHeader + STATE_UPDATE payload
+
+struct RelayConfig {
+    const char* server_ip = "127.0.0.1";
+    int port = RELAY_PORT;
+    uint16_t room = ANY_ROOM;
+    int max_viewers = DEFAULT_MAX_VIEWERS;
+};
+
+struct Viewer {
+    int fd = -1; // -1 means the slot is free
+    bool watching = false; // Sent SPECTATE and got its WelcomePacket
+    StreamBuffer rx{256, 32}; // Only JoinPackets and AckPackets, with room for fields newer viewers append
+    uint32_t acked_snapshot = 0; // Delta baseline (0 = send full)
+    Frame in_flight;             // Being written, from in_flight_offset on
+    size_t in_flight_offset = 0;
+    Frame next;                  // Goes out once in_flight is done; replaced if a newer snapshot arrives first
+};
+
+struct RelayStats {
+    uint64_t snapshots = 0;
+    uint64_t encodings = 0;
+    uint64_t frames_sent = 0;
+    uint64_t frames_skipped = 0; // Replaced before a slow viewer got to them
+};
+
+static bool parse_args(int argc, char* argv[], RelayConfig& config) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            config.port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--room") == 0 && i + 1 < argc) {
+            config.room = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-viewers") == 0 && i + 1 < argc) {
+            config.max_viewers = atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            config.server_ip = argv[i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [SERVER_IP] [--port PORT] [--room N] [--max-viewers N]\n";
+            return false;
+        }
+    }
+    if (config.port < 1 || config.port > 65535 || config.max_viewers < 1 || config.max_viewers > 0xFFFF) {
+        std::cerr << "--port must be between 1 and 65535, --max-viewers between 1 and 65535\n";
+        return false;
+    }
+    return true;
+}
+
+// Write as much of the viewer's frames as the socket takes. false if the viewer is gone.
+static bool flush_viewer(Viewer& viewer, RelayStats& stats) {
+    while (viewer.in_flight) {
+        const std::vector<uint8_t>& frame = *viewer.in_flight;
+        ssize_t sent = send(viewer.fd, frame.data() + viewer.in_flight_offset, frame.size() - viewer.in_flight_offset,
+                            MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK; // EPOLLOUT brings us back
+        }
+        viewer.in_flight_offset += (size_t)sent;
+        if (viewer.in_flight_offset < frame.size()) continue;
+        stats.frames_sent++;
+        viewer.in_flight.swap(viewer.next);
+        viewer.next.reset();
+        viewer.in_flight_offset = 0;
+    }
+    return true;
+}
+
+static void drop_viewer(std::vector<Viewer>& viewers, uint16_t v, std::vector<uint16_t>& free_viewers) {
+    Viewer& viewer = viewers[v];
+    close(viewer.fd); // Also takes it out of the epoll set
+    viewer.fd = -1;
+    viewer.watching = false;
+    viewer.in_flight.reset();
+    viewer.next.reset();
+    free_viewers.push_back(v);
+}
+
+int main(int argc, char* argv[]) {
+    RelayConfig config;
+    if (!parse_args(argc, argv, config)) return 1;
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        rlim_t wanted = (rlim_t)config.max_viewers + 64;
+        if (limit.rlim_cur < wanted) {
+            limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || wanted < limit.rlim_max) ? wanted : limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+    // 1. Upstream: watch a room of server_app like any spectator would
+    sockaddr_in serv_addr{};
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(SERVER_PORT);
+    if (inet_pton(AF_INET, config.server_ip, &serv_addr.sin_addr) <= 0) {
+        std::cerr << "Invalid address\n";
+        return 1;
+    }
+    int upstream = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (upstream < 0 || connect(upstream, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+        std::cerr << "Could not connect to " << config.server_ip << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    int opt = 1;
+    setsockopt(upstream, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    JoinPacket join;
+    join.room = config.room;
+    join.version = PROTOCOL_VERSION;
+    SendBuffer upstream_tx(16 * 1024); // Acks the socket didn't take yet: seconds of them before we give up
+    if (!upstream_tx.send_frame(upstream, SPECTATE, join)) { // Still blocking here: it all goes or it fails
+        std::cerr << "Could not ask to spectate: " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    // The WelcomePacket comes first; snapshots may already be queued behind it in the same buffer
+    StreamBuffer upstream_rx(64 * 1024, GAME_STATE_HEADER_SIZE + sizeof(EntityState) * MAX_PLAYERS_LIMIT);
+    WelcomePacket welcome;
+    bool welcomed = false;
+    while (!welcomed) {
+        ssize_t bytes = upstream_rx.recv_from(upstream);
+        if (bytes <= 0) {
+            std::cerr << "The server closed the connection before welcoming us\n";
+            return 1;
+        }
+        FrameHeader header;
+        const uint8_t* payload = NULL;
+        StreamBuffer::Result result = upstream_rx.next_frame(header, payload);
+        if (result == StreamBuffer::BAD_FRAME) return 1;
+        if (result != StreamBuffer::FRAME) continue;
+        if (header.type != JOIN || !wire::decode(payload, header.length, welcome)) {
+            std::cerr << "The server did not welcome us\n";
+            return 1;
+        }
+        welcomed = true;
+    }
+    fcntl(upstream, F_SETFL, fcntl(upstream, F_GETFL, 0) | O_NONBLOCK);
+
+    // 2. Downstream listener
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(config.port);
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+        std::cerr << "Could not listen on port " << config.port << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    // Every viewer gets the same welcome, so it is encoded once and shared like a snapshot frame
+    WelcomePacket reply = welcome;
+    reply.assigned_id = SPECTATOR_ID;
+    reply.udp_token = 0;
+    reply.udp_port = 0;
+    std::vector<uint8_t> welcome_bytes(FRAME_HEADER_SIZE + wire::Size<WelcomePacket>::value);
+    wire::encode(write_frame_header(welcome_bytes.data(), JOIN, (uint32_t)wire::Size<WelcomePacket>::value), reply);
+    const Frame welcome_frame = std::make_shared<const std::vector<uint8_t> >(welcome_bytes);
+
+    std::cout << "Relaying room " << welcome.room << " of " << config.server_ip << " (" << welcome.tick_rate
+              << " Hz) to viewers on port " << config.port << "\n";
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET; // EPOLLOUT: room again for a backed-up upstream_tx
+    event.data.u32 = UPSTREAM_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, upstream, &event);
+    event.events = EPOLLIN | EPOLLET;
+    event.data.u32 = LISTEN_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+
+    std::vector<Viewer> viewers(config.max_viewers);
+    std::vector<uint16_t> free_viewers;
+    for (int v = config.max_viewers - 1; v >= 0; v--) free_viewers.push_back((uint16_t)v);
+
+    SnapshotRing history; // Decoded upstream snapshots: what we diff against for viewers
+    Snapshot decoded;
+    uint32_t last_snapshot = 0;
+    RelayStats stats;
+    std::vector<std::pair<uint32_t, Frame> > encoded; // This snapshot's frames, by baseline seq
+    std::vector<uint8_t> scratch;
+
+    // Encode the newest snapshot for every watching viewer and queue it behind whatever they are sending
+    auto fan_out = [&](const Snapshot& current) {
+        encoded.clear();
+        for (size_t v = 0; v < viewers.size(); v++) {
+            Viewer& viewer = viewers[v];
+            if (viewer.fd < 0 || !viewer.watching) continue;
+            const Snapshot* baseline = history.find(viewer.acked_snapshot);
+            uint32_t baseline_seq = baseline ? baseline->seq : 0;
+            Frame frame;
+            for (size_t k = 0; k < encoded.size() && !frame; k++) {
+                if (encoded[k].first == baseline_seq) frame = encoded[k].second;
+            }
+            if (!frame) {
+                scratch.resize(FRAME_HEADER_SIZE);
+                encode_snapshot(current, baseline, scratch);
+                write_frame_header(scratch.data(), STATE_UPDATE, (uint32_t)(scratch.size() - FRAME_HEADER_SIZE));
+                frame = std::make_shared<const std::vector<uint8_t> >(scratch);
+                encoded.push_back(std::make_pair(baseline_seq, frame));
+                stats.encodings++;
+            }
+
+            if (!viewer.in_flight) {
+                viewer.in_flight = frame;
+                viewer.in_flight_offset = 0;
+            } else {
+                if (viewer.next) stats.frames_skipped++;
+                viewer.next = frame; // Deltas are against the viewer's ack, so skipping one loses nothing
+            }
+            if (!flush_viewer(viewer, stats)) drop_viewer(viewers, (uint16_t)v, free_viewers);
+        }
+    };
+
+    // Drain the upstream stream, relaying the newest snapshot of each batch and acking it
+    auto read_upstream = [&]() -> bool {
+        FrameHeader header;
+        const uint8_t* payload = NULL;
+        while (true) {
+            // Into upstream_rx: stays put through NEED_MORE, until the recv_from() below
+            const uint8_t* latest_state = NULL;
+            uint32_t latest_length = 0;
+            StreamBuffer::Result result;
+            while ((result = upstream_rx.next_frame(header, payload)) == StreamBuffer::FRAME) {
+                if (header.type == STATE_UPDATE && header.length >= GAME_STATE_HEADER_SIZE) {
+                    latest_state = payload; // Older snapshots in this batch are already stale
+                    latest_length = header.length;
+                }
+            }
+            if (result == StreamBuffer::BAD_FRAME) {
+                std::cerr << "Server sent an oversized frame (" << header.length << " bytes)\n";
+                return false;
+            }
+            GameStatePacket packet;
+            if (latest_state && wire::decode(latest_state, latest_length, packet) && packet.seq > last_snapshot &&
+                decode_snapshot(latest_state, latest_length, history, decoded)) {
+                Snapshot& stored = history.insert(decoded.seq);
+                stored.server_time = decoded.server_time;
+                stored.entities.swap(decoded.entities);
+                last_snapshot = stored.seq;
+                stats.snapshots++;
+                AckPacket ack;
+                ack.ack = last_snapshot;
+                if (!upstream_tx.send_frame(upstream, ACK, ack)) {
+                    std::cerr << "Connection error while acking: " << strerror(errno) << "\n";
+                    return false;
+                }
+                fan_out(stored);
+            }
+
+            ssize_t bytes = upstream_rx.recv_from(upstream);
+            if (bytes == 0) return false;
+            if (bytes < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EWOULDBLOCK || errno == EAGAIN) return true; // Drained
+                std::cerr << "Connection error while receiving game state: " << strerror(errno) << "\n";
+                return false;
+            }
+        }
+    };
+
+    // A viewer's first frame must be SPECTATE; after that it only sends acks
+    auto read_viewer = [&](uint16_t v) {
+        Viewer& viewer = viewers[v];
+        while (viewer.fd >= 0) {
+            ssize_t bytes = viewer.rx.recv_from(viewer.fd);
+            if (bytes == 0 || (bytes < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                drop_viewer(viewers, v, free_viewers);
+                return;
+            }
+            if (bytes < 0 && errno == EINTR) continue;
+
+            FrameHeader header;
+            const uint8_t* payload = NULL;
+            JoinPacket request;
+            AckPacket ack;
+            StreamBuffer::Result result;
+            while (viewer.fd >= 0 && (result = viewer.rx.next_frame(header, payload)) == StreamBuffer::FRAME) {
+                if (!viewer.watching) {
+                    if (header.type != SPECTATE || !wire::decode(payload, header.length, request)) {
+                        drop_viewer(viewers, v, free_viewers); // A relay has no player slots to offer
+                        return;
+                    }
+                    // Nothing is queued before the welcome, and snapshots only start once it is: it goes first
+                    viewer.in_flight = welcome_frame;
+                    viewer.in_flight_offset = 0;
+                    viewer.watching = true;
+                    if (!flush_viewer(viewer, stats)) {
+                        drop_viewer(viewers, v, free_viewers);
+                        return;
+                    }
+                } else if (header.type == ACK && wire::decode(payload, header.length, ack)) {
+                    if (ack.ack > viewer.acked_snapshot && ack.ack <= last_snapshot) viewer.acked_snapshot = ack.ack;
+                }
+            }
+            if (viewer.fd >= 0 && result == StreamBuffer::BAD_FRAME) drop_viewer(viewers, v, free_viewers);
+            if (bytes < 0) return; // Drained
+        }
+    };
+
+    std::vector<epoll_event> events(256);
+    double next_report = monotonic_seconds() + REPORT_SECONDS;
+    bool open = read_upstream(); // Snapshots that arrived behind the WelcomePacket
+    while (open) {
+        int ready = epoll_wait(epoll_fd, events.data(), (int)events.size(), 1000);
+        for (int e = 0; e < ready && open; e++) {
+            uint32_t tag = events[e].data.u32;
+            if (tag == UPSTREAM_TAG) {
+                if (events[e].events & EPOLLOUT) open = upstream_tx.flush(upstream);
+                if (!open) std::cerr << "Connection error while acking: " << strerror(errno) << "\n";
+                if (open && (events[e].events & ~EPOLLOUT)) open = read_upstream();
+            } else if (tag == LISTEN_TAG) {
+                while (true) {
+                    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (fd < 0) break;
+                    if (free_viewers.empty()) {
+                        close(fd); // Full
+                        continue;
+                    }
+                    uint16_t v = free_viewers.back();
+                    free_viewers.pop_back();
+                    Viewer& viewer = viewers[v];
+                    viewer.fd = fd;
+                    viewer.rx.clear();
+                    viewer.acked_snapshot = 0;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+                    int send_buffer = VIEWER_SEND_BUFFER;
+                    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &send_buffer, sizeof(send_buffer));
+                    epoll_event viewer_event{};
+                    viewer_event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                    viewer_event.data.u32 = v;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &viewer_event);
+                }
+            } else {
+                Viewer& viewer = viewers[tag];
+                if ((events[e].events & EPOLLOUT) && viewer.fd >= 0 && !flush_viewer(viewer, stats)) {
+                    drop_viewer(viewers, (uint16_t)tag, free_viewers);
+                }
+                if ((events[e].events & ~EPOLLOUT) && viewer.fd >= 0) read_viewer((uint16_t)tag);
+            }
+        }
+
+        double now = monotonic_seconds();
+        if (now >= next_report) {
+            std::cout << viewers.size() - free_viewers.size() << " viewers, " << stats.snapshots << " snapshots, "
+                      << (stats.snapshots ? (double)stats.encodings / stats.snapshots : 0.0) << " encodings/snapshot, "
+                      << stats.frames_sent << " frames sent, " << stats.frames_skipped << " skipped\n";
+            next_report = now + REPORT_SECONDS;
+        }
+    }
+
+    std::cout << "The server closed the connection\n";
+    for (size_t v = 0; v < viewers.size(); v++) {
+        if (viewers[v].fd >= 0) close(viewers[v].fd);
+    }
+    close(listen_fd);
+    close(epoll_fd);
+    close(upstream);
+    return 0;
+}
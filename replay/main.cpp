@@ -0,0 +1,199 @@
+#include <iostream>
+#include <vector>
+#include <algorithm> // nth_element() for percentiles
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h> // The log is read straight out of the page cache
+#include <sys/stat.h>
+#include "../common/clock.h"
+#include "../server/world.h"
+#include "../server/recording.h"
+
+// --- Offline replay ---
+//
+// replay_app runs a log written by `server_app --record` through the simulation with no sockets and no
+// tick clock: every tick runs back to back. It checks the world hash after each tick against the one the
+// server recorded, so a change to world.cpp or the hit kernel that alters any outcome is caught, and it
+// reports how long each tick took, so the same real workload can be timed before and after a change.
+
+struct ReplayConfig {
+    const char* path = NULL;
+    int repeat = 1;      // Passes over the log (more passes = steadier timings)
+    bool verify = true;  // Compare world hashes (costs one pass over the players per tick)
+};
+
+struct PassResult {
+    uint64_t ticks = 0;
+    uint64_t mismatches = 0;
+    uint32_t first_mismatch = 0; // Tick number, 0 = none
+    int peak_players = 0;
+    bool truncated = false;
+    bool corrupt = false;
+};
+
+static bool parse_args(int argc, char* argv[], ReplayConfig& config) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            config.repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-verify") == 0) {
+            config.verify = false;
+        } else if (argv[i][0] != '-' && !config.path) {
+            config.path = argv[i];
+        } else {
+            config.path = NULL;
+            break;
+        }
+    }
+    if (!config.path || config.repeat < 1) {
+        std::cerr << "Usage: " << argv[0] << " RECORDING [--repeat N] [--no-verify]\n";
+        return false;
+    }
+    return true;
+}
+
+// Value below which `fraction` of the samples fall. Reorders the samples.
+static uint64_t percentile(std::vector<uint64_t>& samples, double fraction) {
+    if (samples.empty()) return 0;
+    size_t k = (size_t)(fraction * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+// One pass over the whole log. tick_ns gets how long each simulated tick took.
+static PassResult replay_pass(RecordingReader& reader, const RecordingHeader& header, bool verify,
+                              World& world, std::vector<PlayerCommand>& commands, std::vector<uint64_t>& tick_ns) {
+    PassResult result;
+    const float dt = 1.0f / header.tick_rate;
+    world.init((int)header.max_players, header.max_rewind_ticks ? header.max_rewind_ticks + 1 : 0);
+    commands.assign(header.max_players, PlayerCommand());
+    std::vector<uint16_t> commanded; // Ids given a command last tick, so clearing costs O(commands), not O(players)
+    int players = 0;
+    reader.rewind();
+
+    RecordType type;
+    uint16_t id = 0, count = 0;
+    uint32_t tick = 0;
+    const RecordedCommand* recorded = NULL;
+    uint64_t hash = 0;
+    RecordingReader::Result status;
+    while ((status = reader.next(type, id, tick, recorded, count, hash)) == RecordingReader::RECORD) {
+        if ((type == REC_JOIN || type == REC_LEAVE) && id >= header.max_players) {
+            result.corrupt = true;
+            break;
+        }
+        if (type == REC_JOIN) {
+            if (!world.active[id]) players++;
+            world.spawn(id);
+            if (players > result.peak_players) result.peak_players = players;
+        } else if (type == REC_LEAVE) {
+            if (world.active[id]) players--;
+            world.despawn(id);
+        } else if (type == REC_RESTART) {
+            world.reset_round();
+        } else {
+            for (size_t k = 0; k < commanded.size(); k++) commands[commanded[k]].present = 0;
+            commanded.clear();
+            for (uint16_t k = 0; k < count; k++) {
+                const RecordedCommand& rc = recorded[k];
+                if (rc.id >= header.max_players) {
+                    result.corrupt = true;
+                    break;
+                }
+                PlayerCommand& cmd = commands[rc.id];
+                cmd.present = 1;
+                cmd.dx = rc.dx;
+                cmd.dy = rc.dy;
+                cmd.rotation = rc.rotation;
+                cmd.attack = rc.attack;
+                cmd.rewind_tick = rc.rewind_tick;
+                commanded.push_back(rc.id);
+            }
+            if (result.corrupt) break;
+
+            // Exactly what Room::run_tick() does between gathering commands and broadcasting
+            uint64_t start = monotonic_ns();
+            simulate_tick(world, commands, dt);
+            if (header.max_rewind_ticks > 0) world.history.record(tick, world);
+            tick_ns.push_back(monotonic_ns() - start);
+            result.ticks++;
+
+            if (verify && world_hash(world) != hash) {
+                if (result.mismatches == 0) result.first_mismatch = tick;
+                result.mismatches++;
+            }
+        }
+    }
+    result.truncated = status == RecordingReader::TRUNCATED;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    ReplayConfig config;
+    if (!parse_args(argc, argv, config)) return 1;
+
+    int fd = open(config.path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        std::cerr << "Could not open " << config.path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    size_t size = (size_t)info.st_size;
+    void* mapped = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Could not map " << config.path << "\n";
+        return 1;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL); // Read once front to back: let the kernel read ahead
+    close(fd); // The mapping keeps the file alive
+
+    RecordingReader reader;
+    RecordingHeader header;
+    if (!reader.open((const uint8_t*)mapped, size, header)) {
+        std::cerr << config.path << " is not a recording this build can read (expected version " << RECORDING_VERSION << ")\n";
+        return 1;
+    }
+    std::cout << "Room " << header.room << ", up to " << header.max_players << " players at " << header.tick_rate
+              << " Hz, rewind " << header.max_rewind_ticks << " ticks, " << size / 1024 << " KB\n";
+
+    World world;
+    std::vector<PlayerCommand> commands;
+    std::vector<uint64_t> tick_ns;
+    PassResult result;
+    uint64_t total_ns = 0;
+    for (int pass = 0; pass < config.repeat; pass++) {
+        uint64_t start = monotonic_ns();
+        result = replay_pass(reader, header, config.verify, world, commands, tick_ns);
+        total_ns += monotonic_ns() - start;
+        if (result.corrupt) {
+            std::cerr << "The recording holds a player id beyond its own max_players; giving up\n";
+            return 1;
+        }
+        if (result.mismatches > 0) break; // Further passes would only repeat the same divergence
+    }
+    if (result.truncated) std::cerr << "Warning: the recording ends mid-record (server killed while writing?)\n";
+
+    uint64_t sum_ns = 0;
+    for (size_t k = 0; k < tick_ns.size(); k++) sum_ns += tick_ns[k];
+    double mean = tick_ns.empty() ? 0.0 : (double)sum_ns / tick_ns.size();
+    printf("--- %llu ticks x %d pass(es), up to %d players ---\n", (unsigned long long)result.ticks, config.repeat,
+           result.peak_players);
+    printf("tick:      mean %.0f ns  p50 %llu ns  p99 %llu ns  max %llu ns\n", mean,
+           (unsigned long long)percentile(tick_ns, 0.50), (unsigned long long)percentile(tick_ns, 0.99),
+           (unsigned long long)percentile(tick_ns, 1.0));
+    printf("rate:      %.0f ticks/s simulated, %.0f ticks/s overall\n", sum_ns ? tick_ns.size() * 1e9 / sum_ns : 0.0,
+           total_ns ? tick_ns.size() * 1e9 / total_ns : 0.0);
+    if (!config.verify) {
+        printf("verify:    skipped\n");
+    } else if (result.mismatches == 0) {
+        printf("verify:    all %llu world hashes match\n", (unsigned long long)result.ticks);
+    } else {
+        printf("verify:    %llu of %llu ticks DIFFER, first at tick %u\n", (unsigned long long)result.mismatches,
+               (unsigned long long)result.ticks, result.first_mismatch);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef CONFIG_H // Include guard to prevent multiple inclusions
+#define CONFIG_H
+
+#include "../common/protocol.h"
+
+// Command line settings, shared read-only by every worker thread once the server is running.
+struct ServerConfig {
+    int max_players = DEFAULT_MAX_PLAYERS; // Per room
+    int tick_rate = DEFAULT_TICK_RATE;
+    bool udp = false; // Offer the UDP transport for inputs and snapshots
+    float view_radius = 0.0f; // Area of interest in pixels; 0 = every client sees every player
+    int max_rewind_ms = 200; // Lag compensation: furthest back a hit test may rewind; 0 = off
+    int rooms = 1;   // Independent matches hosted by this process
+    int workers = 0; // Event loop threads, one per core; 0 = one per core, but no more than there are rooms
+    int metrics_port = 0; // Serve Prometheus text metrics on 127.0.0.1:PORT; 0 = off
+    const char* record_path = NULL; // Append every room's inputs to this file (room N of several: FILE.N); NULL = off
+};
+
+#endif // CONFIG_H
@@ -0,0 +1,222 @@
+#include "hit_kernel.h"
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+SweptCapsule make_swept_capsule(float px, float py, float from, float to, bool swept, float inner, float outer, float radius) {
+    SweptCapsule s;
+    s.px = px;
+    s.py = py;
+    s.d1x = std::cos(to);
+    s.d1y = std::sin(to);
+    s.d0x = s.d1x;
+    s.d0y = s.d1y;
+    s.inner = inner;
+    s.outer = outer;
+    s.radius = radius;
+    s.swept = swept && from != to;
+    if (s.swept) {
+        float fx = std::cos(from);
+        float fy = std::sin(from);
+        // Order the edges so the slice runs from d0 to d1 the short way round (cross(d0, d1) >= 0). A half
+        // turn has no short way, and its cross product is rounding noise: always sweep it counter-clockwise
+        // from `from` instead of letting the noise pick
+        float cross = fx * s.d1y - fy * s.d1x;
+        bool half_turn = cross > -1e-6f && cross < 1e-6f && fx * s.d1x + fy * s.d1y < 0.0f;
+        if (cross >= 0.0f || half_turn) {
+            s.d0x = fx;
+            s.d0y = fy;
+        } else {
+            s.d0x = s.d1x;
+            s.d0y = s.d1y;
+            s.d1x = fx;
+            s.d1y = fy;
+        }
+    }
+    s.bx = s.d0x + s.d1x;
+    s.by = s.d0y + s.d1y;
+    // Half a turn: d0 + d1 vanishes (or is left as rounding noise), so take d0 rotated a quarter turn
+    // towards d1 - then the slice is exactly the half-plane on d0's counter-clockwise side
+    if (s.bx * s.bx + s.by * s.by < 1e-6f) {
+        s.bx = -s.d0y;
+        s.by = s.d0x;
+    }
+    return s;
+}
+
+void swept_capsule_bounds(const SweptCapsule& s, float& min_x, float& min_y, float& max_x, float& max_y) {
+    // Newspaper ends at both edges of the swing...
+    float px[4] = { s.d0x * s.inner, s.d0x * s.outer, s.d1x * s.inner, s.d1x * s.outer };
+    float py[4] = { s.d0y * s.inner, s.d0y * s.outer, s.d1y * s.inner, s.d1y * s.outer };
+    min_x = max_x = px[0];
+    min_y = max_y = py[0];
+    for (int k = 1; k < 4; k++) {
+        if (px[k] < min_x) min_x = px[k];
+        if (px[k] > max_x) max_x = px[k];
+        if (py[k] < min_y) min_y = py[k];
+        if (py[k] > max_y) max_y = py[k];
+    }
+    // ...plus the tip's outermost point on any axis the swing passes through
+    if (s.swept) {
+        const float axes[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+        for (int a = 0; a < 4; a++) {
+            float ax = axes[a][0], ay = axes[a][1];
+            bool inside = s.d0x * ay - s.d0y * ax >= 0.0f && ax * s.d1y - ay * s.d1x >= 0.0f &&
+                          ax * s.bx + ay * s.by > 0.0f;
+            if (!inside) continue;
+            if (ax * s.outer < min_x) min_x = ax * s.outer;
+            if (ax * s.outer > max_x) max_x = ax * s.outer;
+            if (ay * s.outer < min_y) min_y = ay * s.outer;
+            if (ay * s.outer > max_y) max_y = ay * s.outer;
+        }
+    }
+    min_x += s.px - s.radius;
+    max_x += s.px + s.radius;
+    min_y += s.py - s.radius;
+    max_y += s.py + s.radius;
+}
+
+// Distance test against one capsule edge: project onto the newspaper, clamp to its extent, compare squared.
+static inline bool in_capsule(float vx, float vy, float dx, float dy, float inner, float outer, float radius_sq) {
+    float t = vx * dx + vy * dy;
+    t = t < inner ? inner : (t > outer ? outer : t);
+    float ex = vx - dx * t;
+    float ey = vy - dy * t;
+    return ex * ex + ey * ey < radius_sq;
+}
+
+int capsule_hits_scalar(const SweptCapsule& s, const float* xs, const float* ys, int count, uint16_t* hits) {
+    const float radius_sq = s.radius * s.radius;
+    const float reach = s.outer + s.radius;
+    const float reach_sq = reach * reach;
+    const float near = s.inner > s.radius ? s.inner - s.radius : 0.0f;
+    const float near_sq = near * near;
+
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        float vx = xs[i] - s.px;
+        float vy = ys[i] - s.py;
+        bool hit = in_capsule(vx, vy, s.d1x, s.d1y, s.inner, s.outer, radius_sq);
+        if (!hit && s.swept) {
+            float len_sq = vx * vx + vy * vy;
+            hit = in_capsule(vx, vy, s.d0x, s.d0y, s.inner, s.outer, radius_sq) ||
+                  (s.d0x * vy - s.d0y * vx >= 0.0f && vx * s.d1y - vy * s.d1x >= 0.0f && vx * s.bx + vy * s.by > 0.0f &&
+                   len_sq < reach_sq && len_sq >= near_sq);
+        }
+        if (hit) hits[found++] = (uint16_t)i;
+    }
+    return found;
+}
+
+#if defined(__AVX__)
+
+static inline __m256 capsule_mask8(__m256 vx, __m256 vy, __m256 dx, __m256 dy, __m256 inner, __m256 outer, __m256 radius_sq) {
+    __m256 t = _mm256_add_ps(_mm256_mul_ps(vx, dx), _mm256_mul_ps(vy, dy));
+    t = _mm256_min_ps(_mm256_max_ps(t, inner), outer);
+    __m256 ex = _mm256_sub_ps(vx, _mm256_mul_ps(dx, t));
+    __m256 ey = _mm256_sub_ps(vy, _mm256_mul_ps(dy, t));
+    __m256 dist_sq = _mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey));
+    return _mm256_cmp_ps(dist_sq, radius_sq, _CMP_LT_OQ);
+}
+
+int capsule_hits(const SweptCapsule& s, const float* xs, const float* ys, int count, uint16_t* hits) {
+    const float reach = s.outer + s.radius;
+    const float near = s.inner > s.radius ? s.inner - s.radius : 0.0f;
+    const __m256 px = _mm256_set1_ps(s.px), py = _mm256_set1_ps(s.py);
+    const __m256 d0x = _mm256_set1_ps(s.d0x), d0y = _mm256_set1_ps(s.d0y);
+    const __m256 d1x = _mm256_set1_ps(s.d1x), d1y = _mm256_set1_ps(s.d1y);
+    const __m256 bx = _mm256_set1_ps(s.bx), by = _mm256_set1_ps(s.by);
+    const __m256 inner = _mm256_set1_ps(s.inner), outer = _mm256_set1_ps(s.outer);
+    const __m256 radius_sq = _mm256_set1_ps(s.radius * s.radius);
+    const __m256 reach_sq = _mm256_set1_ps(reach * reach), near_sq = _mm256_set1_ps(near * near);
+    const __m256 zero = _mm256_setzero_ps();
+
+    int found = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 vx = _mm256_sub_ps(_mm256_loadu_ps(xs + i), px);
+        __m256 vy = _mm256_sub_ps(_mm256_loadu_ps(ys + i), py);
+        __m256 mask = capsule_mask8(vx, vy, d1x, d1y, inner, outer, radius_sq);
+        if (s.swept) {
+            mask = _mm256_or_ps(mask, capsule_mask8(vx, vy, d0x, d0y, inner, outer, radius_sq));
+            __m256 len_sq = _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy));
+            __m256 after_d0 = _mm256_cmp_ps(_mm256_sub_ps(_mm256_mul_ps(d0x, vy), _mm256_mul_ps(d0y, vx)), zero, _CMP_GE_OQ);
+            __m256 before_d1 = _mm256_cmp_ps(_mm256_sub_ps(_mm256_mul_ps(vx, d1y), _mm256_mul_ps(vy, d1x)), zero, _CMP_GE_OQ);
+            __m256 forward = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(vx, bx), _mm256_mul_ps(vy, by)), zero, _CMP_GT_OQ);
+            __m256 in_reach = _mm256_and_ps(_mm256_cmp_ps(len_sq, reach_sq, _CMP_LT_OQ), _mm256_cmp_ps(len_sq, near_sq, _CMP_GE_OQ));
+            mask = _mm256_or_ps(mask, _mm256_and_ps(_mm256_and_ps(after_d0, before_d1), _mm256_and_ps(forward, in_reach)));
+        }
+        unsigned bits = (unsigned)_mm256_movemask_ps(mask);
+        for (int k = 0; k < 8; k++) { // Branch-free compaction, see the SSE2 version
+            hits[found] = (uint16_t)(i + k);
+            found += (bits >> k) & 1;
+        }
+    }
+    int tail = capsule_hits_scalar(s, xs + i, ys + i, count - i, hits + found);
+    for (int k = 0; k < tail; k++) hits[found + k] += (uint16_t)i;
+    return found + tail;
+}
+
+#elif defined(__SSE2__)
+
+static inline __m128 capsule_mask4(__m128 vx, __m128 vy, __m128 dx, __m128 dy, __m128 inner, __m128 outer, __m128 radius_sq) {
+    __m128 t = _mm_add_ps(_mm_mul_ps(vx, dx), _mm_mul_ps(vy, dy));
+    t = _mm_min_ps(_mm_max_ps(t, inner), outer);
+    __m128 ex = _mm_sub_ps(vx, _mm_mul_ps(dx, t));
+    __m128 ey = _mm_sub_ps(vy, _mm_mul_ps(dy, t));
+    __m128 dist_sq = _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey));
+    return _mm_cmplt_ps(dist_sq, radius_sq);
+}
+
+int capsule_hits(const SweptCapsule& s, const float* xs, const float* ys, int count, uint16_t* hits) {
+    const float reach = s.outer + s.radius;
+    const float near = s.inner > s.radius ? s.inner - s.radius : 0.0f;
+    const __m128 px = _mm_set1_ps(s.px), py = _mm_set1_ps(s.py);
+    const __m128 d0x = _mm_set1_ps(s.d0x), d0y = _mm_set1_ps(s.d0y);
+    const __m128 d1x = _mm_set1_ps(s.d1x), d1y = _mm_set1_ps(s.d1y);
+    const __m128 bx = _mm_set1_ps(s.bx), by = _mm_set1_ps(s.by);
+    const __m128 inner = _mm_set1_ps(s.inner), outer = _mm_set1_ps(s.outer);
+    const __m128 radius_sq = _mm_set1_ps(s.radius * s.radius);
+    const __m128 reach_sq = _mm_set1_ps(reach * reach), near_sq = _mm_set1_ps(near * near);
+    const __m128 zero = _mm_setzero_ps();
+
+    int found = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_sub_ps(_mm_loadu_ps(xs + i), px);
+        __m128 vy = _mm_sub_ps(_mm_loadu_ps(ys + i), py);
+        __m128 mask = capsule_mask4(vx, vy, d1x, d1y, inner, outer, radius_sq);
+        if (s.swept) {
+            mask = _mm_or_ps(mask, capsule_mask4(vx, vy, d0x, d0y, inner, outer, radius_sq));
+            __m128 len_sq = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+            __m128 after_d0 = _mm_cmpge_ps(_mm_sub_ps(_mm_mul_ps(d0x, vy), _mm_mul_ps(d0y, vx)), zero);
+            __m128 before_d1 = _mm_cmpge_ps(_mm_sub_ps(_mm_mul_ps(vx, d1y), _mm_mul_ps(vy, d1x)), zero);
+            __m128 forward = _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(vx, bx), _mm_mul_ps(vy, by)), zero);
+            __m128 in_reach = _mm_and_ps(_mm_cmplt_ps(len_sq, reach_sq), _mm_cmpge_ps(len_sq, near_sq));
+            mask = _mm_or_ps(mask, _mm_and_ps(_mm_and_ps(after_d0, before_d1), _mm_and_ps(forward, in_reach)));
+        }
+        unsigned bits = (unsigned)_mm_movemask_ps(mask);
+        // Branch-free compaction: every lane writes its index, and only hits advance past it. In a crowd
+        // about every other lane hits, so a loop over the set bits would mispredict on most batches. The
+        // writes stay inside `hits`: found never passes the candidate being written.
+        for (int k = 0; k < 4; k++) {
+            hits[found] = (uint16_t)(i + k);
+            found += (bits >> k) & 1;
+        }
+    }
+    int tail = capsule_hits_scalar(s, xs + i, ys + i, count - i, hits + found);
+    for (int k = 0; k < tail; k++) hits[found + k] += (uint16_t)i;
+    return found + tail;
+}
+
+#else
+
+int capsule_hits(const SweptCapsule& s, const float* xs, const float* ys, int count, uint16_t* hits) {
+    return capsule_hits_scalar(s, xs, ys, count, hits);
+}
+
+#endif
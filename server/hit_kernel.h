@@ -0,0 +1,40 @@
+#ifndef HIT_KERNEL_H // Include guard to prevent multiple inclusions
+#define HIT_KERNEL_H
+
+#include <stdint.h>
+
+// --- Newspaper hit test ---
+//
+// The newspaper is a segment from `inner` to `outer` pixels out from the attacker's centre, pointing along
+// their rotation. A victim (circle of `radius`) is hit when it is within `radius` of that segment - a
+// capsule test - anywhere along the swing between last tick's rotation and this tick's. The swept shape is
+// the two end-of-swing capsules plus the pie slice between them, so fast flicks can't skip over a target.
+//
+// capsule_hits() tests one attacker against a packed batch of candidate positions, 8 (AVX) or 4 (SSE)
+// candidates per instruction, with a scalar loop for the remainder or when neither is available.
+
+struct SweptCapsule {
+    float px, py;   // Attacker centre (the swing pivot)
+    float d0x, d0y; // Unit direction at the start of the swing (counter-clockwise edge of the slice)
+    float d1x, d1y; // Unit direction at the end of the swing
+    float bx, by;   // Points into the slice (bisector); rejects its mirror image across the pivot
+    float inner;    // Distance from the pivot to the newspaper's handle
+    float outer;    // Distance from the pivot to the tip
+    float radius;   // Victim hitbox radius
+    bool swept;     // false = only the capsule along d1 (no swing since the previous tick)
+};
+
+// Build the shape for a swing from rotation `from` to `to` (radians). Sweeps the short way around;
+// with swept == false only `to` is used. A half turn has no short way; it sweeps counter-clockwise from `from`.
+SweptCapsule make_swept_capsule(float px, float py, float from, float to, bool swept, float inner, float outer, float radius);
+
+// Axis-aligned box around everything the swing can hit (for narrowing grid queries).
+void swept_capsule_bounds(const SweptCapsule& shape, float& min_x, float& min_y, float& max_x, float& max_y);
+
+// Writes the batch index of every hit candidate to `hits` (room for `count` entries) and returns how many.
+int capsule_hits(const SweptCapsule& shape, const float* xs, const float* ys, int count, uint16_t* hits);
+
+// Plain C++ version of the same test; used for batch tails. kernel_check holds the vector paths to it.
+int capsule_hits_scalar(const SweptCapsule& shape, const float* xs, const float* ys, int count, uint16_t* hits);
+
+#endif // HIT_KERNEL_H
@@ -0,0 +1,45 @@
+#include "interest.h"
+#include <algorithm>
+
+int find_leader(const World& world) {
+    int leader = -1;
+    for (int i = 0; i < world.capacity; i++) {
+        if (world.active[i] && (leader < 0 || world.score[i] > world.score[leader])) leader = i;
+    }
+    return leader;
+}
+
+void gather_visible(const World& world, int viewer, float radius, int leader, std::vector<uint16_t>& out) {
+    out.clear();
+    const SpatialGrid& grid = world.grid;
+    float cx = world.x[viewer];
+    float cy = world.y[viewer];
+    float r2 = radius * radius;
+    grid.query_spans(cx - radius, cy - radius, cx + radius, cy + radius, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t k = begin; k < end; k++) {
+            float dx = grid.xs[k] - cx;
+            float dy = grid.ys[k] - cy;
+            if (dx * dx + dy * dy <= r2) out.push_back(grid.entries[k]);
+        }
+    });
+    // Always relevant, wherever they are (duplicates are removed below)
+    out.push_back((uint16_t)viewer);
+    if (leader >= 0) out.push_back((uint16_t)leader);
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+void filter_snapshot(const Snapshot& full, const std::vector<uint16_t>& ids, Snapshot& out) {
+    out.seq = full.seq;
+    out.server_time = full.server_time;
+    out.entities.clear();
+    // Both sides are sorted: one binary search per wanted id, each starting from the previous match, so
+    // the cost follows the size of the view rather than the number of players on the server
+    std::vector<EntityState>::const_iterator from = full.entities.begin();
+    for (size_t k = 0; k < ids.size(); k++) {
+        from = std::lower_bound(from, full.entities.end(), ids[k],
+                                [](const EntityState& e, uint16_t id) { return e.id < id; });
+        if (from == full.entities.end()) break;
+        if (from->id == ids[k]) out.entities.push_back(*from);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef INTEREST_H // Include guard to prevent multiple inclusions
+#define INTEREST_H
+
+#include <stdint.h>
+#include <vector>
+#include "../common/snapshot.h"
+#include "world.h"
+
+// --- Area of interest ---
+//
+// With a view radius set, each client's snapshot only holds the players near it, plus itself and the
+// current leader (whose score decides the round). Everyone else is left out, so what a client costs to
+// encode and send depends on how crowded its surroundings are, not on the size of the whole server.
+//
+// Deltas still work: the server remembers which ids went into each snapshot it sent a client, and rebuilds
+// that client's view of its acked baseline from the shared history. A player walking out of view is sent
+// as a removal, one walking in as a full record - the client's decoder needs no changes.
+
+// The ids that went into one snapshot sent to one client.
+struct InterestSet {
+    uint32_t seq = 0;          // 0 = empty slot
+    std::vector<uint16_t> ids; // Sorted
+};
+
+// Per-client ring of recent interest sets, indexed like SnapshotRing so both age out together.
+struct InterestHistory {
+    InterestSet slots[SNAPSHOT_HISTORY];
+
+    const InterestSet* find(uint32_t seq) const {
+        if (seq == 0) return NULL;
+        const InterestSet& s = slots[seq % SNAPSHOT_HISTORY];
+        return s.seq == seq ? &s : NULL;
+    }
+
+    InterestSet& insert(uint32_t seq) {
+        InterestSet& s = slots[seq % SNAPSHOT_HISTORY];
+        s.seq = seq;
+        s.ids.clear();
+        return s;
+    }
+
+    void clear() {
+        for (int i = 0; i < SNAPSHOT_HISTORY; i++) slots[i].seq = 0;
+    }
+};
+
+// Highest-scoring active player (lowest id on ties), or -1 if nobody is playing.
+int find_leader(const World& world);
+
+// Sorted ids of every active player within `radius` of `viewer`, plus the viewer and `leader`.
+// Reads world.grid, which must have been built from the current positions.
+void gather_visible(const World& world, int viewer, float radius, int leader, std::vector<uint16_t>& out);
+
+// Copy the entities of `full` whose ids are in `ids` (both sorted) into `out`, keeping full's seq and timestamp.
+void filter_snapshot(const Snapshot& full, const std::vector<uint16_t>& ids, Snapshot& out);
+
+#endif // INTEREST_H
@@ -0,0 +1,113 @@
+#include "log.h"
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+namespace {
+
+struct LogSlot {
+    std::atomic<size_t> sequence; // == position: free for that producer; == position + 1: holds a line
+    uint16_t length;
+    char text[LOG_LINE_MAX];
+};
+
+struct LogQueue {
+    LogSlot slots[LOG_QUEUE_SIZE];
+    // Producers and the consumer advance different counters; keep them on separate cache lines
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+    alignas(64) std::atomic<uint64_t> dropped{0};
+
+    LogQueue() {
+        for (size_t i = 0; i < LOG_QUEUE_SIZE; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // Claim the next free slot, or NULL if the queue is full. The caller fills it and calls publish().
+    LogSlot* claim(size_t& pos) {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            LogSlot& slot = slots[pos & (LOG_QUEUE_SIZE - 1)];
+            intptr_t diff = (intptr_t)slot.sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return &slot;
+            } else if (diff < 0) {
+                return NULL; // The consumer hasn't freed this slot from the previous lap yet
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed); // Another producer took it
+            }
+        }
+    }
+
+    void publish(LogSlot* slot, size_t pos) { slot->sequence.store(pos + 1, std::memory_order_release); }
+
+    // Copy the oldest line into out (at least LOG_LINE_MAX + 1 bytes). Returns its length, or -1 if empty.
+    int pop(char* out) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            LogSlot& slot = slots[pos & (LOG_QUEUE_SIZE - 1)];
+            intptr_t diff = (intptr_t)slot.sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    int length = slot.length;
+                    memcpy(out, slot.text, length);
+                    slot.sequence.store(pos + LOG_QUEUE_SIZE, std::memory_order_release); // Free for the next lap
+                    return length;
+                }
+            } else if (diff < 0) {
+                return -1;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+LogQueue queue;
+
+// Drain everything queued into one buffer and write it with a single fwrite(), then nap if idle.
+void writer() {
+    static char batch[64 * 1024];
+    while (true) {
+        size_t used = 0;
+        int length;
+        while (used + LOG_LINE_MAX + 1 <= sizeof(batch) && (length = queue.pop(batch + used)) >= 0) {
+            used += length;
+            batch[used++] = '\n';
+        }
+        if (used > 0) {
+            fwrite(batch, 1, used, stdout);
+            fflush(stdout);
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+}
+
+} // namespace
+
+void log_start() {
+    std::thread(writer).detach();
+}
+
+void log_line(const char* format, ...) {
+    size_t pos;
+    LogSlot* slot = queue.claim(pos);
+    if (!slot) {
+        queue.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(slot->text, LOG_LINE_MAX, format, args);
+    va_end(args);
+    if (length < 0) length = 0;
+    slot->length = (uint16_t)(length < LOG_LINE_MAX ? length : LOG_LINE_MAX - 1);
+    queue.publish(slot, pos);
+}
+
+uint64_t log_dropped() {
+    return queue.dropped.load(std::memory_order_relaxed);
+}
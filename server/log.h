@@ -0,0 +1,25 @@
+#ifndef LOG_H // Include guard to prevent multiple inclusions
+#define LOG_H
+
+#include <stdint.h>
+
+// --- Async logging ---
+//
+// Worker threads must never wait on a slow terminal or a full pipe, so log_line() only formats the
+// message into a slot of a bounded lock-free queue (Dmitry Vyukov's MPMC ring: one atomic increment
+// to claim a slot, one release store to publish it). A background thread drains the queue and writes
+// whole batches to stdout. If the queue is full the line is dropped and counted instead of blocking.
+
+static const int LOG_QUEUE_SIZE = 4096; // Lines in flight; must be a power of two
+static const int LOG_LINE_MAX = 240;    // Longer lines are truncated
+
+// Start the writer thread. Lines logged before this wait in the queue.
+void log_start();
+
+// printf-style; the newline is added.
+void log_line(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+// Lines lost because the queue was full.
+uint64_t log_dropped();
+
+#endif // LOG_H
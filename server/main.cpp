@@ -1,211 +1,163 @@
 #include <iostream>
-#include <vector> // a dynamic array for managing multiple clients
+#include <vector> // a dynamic array for managing rooms and workers
 #include <string.h>
-#include <unistd.h> // "Unix standard" header for close() and read()
-#include <arpa/inet.h> //for IP address manipulation
-#include <sys/socket.h>
-#include <netinet/tcp.h> // for TCP_NODELAY
-#include <sys/select.h>
+#include <errno.h>
+#include <stdlib.h> // strtol() for command line parsing
+#include <thread> // One worker thread per core
+#include <pthread.h> // pthread_setaffinity_np() to pin each worker to its core
+#include <sys/resource.h> // setrlimit() so we can hold thousands of sockets
 #include "../common/protocol.h"
+#include "config.h"
+#include "room.h"
+#include "worker.h"
+#include "metrics.h"
+#include "log.h"
 #include <signal.h>
-#include <cmath>
 
-int main(){
-    signal(SIGPIPE, SIG_IGN); // Ignore SIGPIPE to prevent crashes when sending to disconnected clients
-    // 1. Create the listening socket
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
-        std::cerr << "Failed to create socket\n";
-        return 1;
-    }
-
-    // 2. Socket Options (Reuse address + Disable Nagle's Algorithm for low latency)
-    int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    setsockopt(server_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
-
-    // 3. Bind to Port
-    sockaddr_in server_addr{}; // curly braces zero-initialize the struct
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    server_addr.sin_port = htons(SERVER_PORT);
-
-    if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        std::cerr << "Bind failed\n";
-        return 1;
-    }
-
-    // 4. Listen for incoming connections
-    listen(server_fd, MAX_PLAYERS);
-    std::cout << "Server listening on port " << SERVER_PORT << "...\n";
-
-    // 5. Setup for select()
-    std::vector<int> client_sockets(MAX_PLAYERS, 0); // Initialize client sockets to 0 (not connected)
-    fd_set readfds;
-
-    // Game State Initialization
-    GameStatePacket game_state = {};
-    game_state.type = STATE_UPDATE;
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        game_state.players[i].id = i;
-        game_state.players[i].active = 0;
-    }
-
-    // 6. The Main Server Loop
-    while (true) {
-        FD_ZERO(&readfds); // this macro clears the set
-        FD_SET(server_fd, &readfds);
-        int max_sd = server_fd; // keep track of the highest file descriptor for select()
-
-        // Add valid client sockets to the read list
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            int sd = client_sockets[i];
-            if (sd > 0) FD_SET(sd, &readfds);
-            if (sd > max_sd) max_sd = sd;
-        }
-
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 16666; // Approximately 60Hz (1/60th of a second)
-
-        // Wait for activity on ANY socket (This blocks indefinitely until data arrives)
-        int activity = select(max_sd + 1, &readfds, NULL, NULL, &timeout);
-        if (activity < 0) { // handle signal interrupts(EINTR)
-            if (errno == EINTR) {
-                continue; // Just a system interrupt, continue
-            } else {
-                perror("Select error"); // A real problem, maybe log it.
-                continue;
+static const int MAX_ROOMS = 4096;
+static const int MAX_WORKERS = 256;
+
+static bool parse_int(const char* text, long min, long max, long& out) {
+    char* end = NULL;
+    out = strtol(text, &end, 10);
+    return *text != '\0' && *end == '\0' && out >= min && out <= max;
+}
+
+static bool parse_args(int argc, char* argv[], ServerConfig& config) {
+    long value = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-players") == 0 && i + 1 < argc) {
+            if (!parse_int(argv[++i], 1, MAX_PLAYERS_LIMIT, value)) {
+                std::cerr << "--max-players must be between 1 and " << MAX_PLAYERS_LIMIT << "\n";
+                return false;
             }
-        }
-        // Event A: New Connection Attempt
-        if (FD_ISSET(server_fd, &readfds)) {
-            sockaddr_in client_addr;
-            socklen_t client_len = sizeof(client_addr);
-            int new_socket = accept(server_fd, (struct sockaddr*)&client_addr, &client_len);
-
-            // Apply TCP_NODELAY to the new client too
-            setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
-
-            // Find an empty slot
-            bool joined = false;
-            for (int i = 0; i < MAX_PLAYERS; i++) {
-                if (client_sockets[i] == 0) {
-                    client_sockets[i] = new_socket;
-
-                    // 1. Prepare and send Welcome Packet
-                    WelcomePacket welcome;
-                    welcome.type = JOIN;
-                    welcome.assigned_id = i;
-                    send(new_socket, &welcome, sizeof(WelcomePacket), 0);
-
-                    // 2. Initialize player state
-                    game_state.players[i].active = 1;
-                    game_state.players[i].x = 700.0f; // Default start X
-                    game_state.players[i].y = 450.0f; // Default start Y
-                    game_state.players[i].rotation = 0.0f;
-                    game_state.players[i].score = 0;
-                    game_state.players[i].is_attacking = 0;
-
-                    std::cout << "Player " << i << " joined!\n";
-                    joined = true;
-                    break;
-                }
+            config.max_players = (int)value;
+        } else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            if (!parse_int(argv[++i], 1, 1000, value)) {
+                std::cerr << "--tick-rate must be between 1 and 1000 Hz\n";
+                return false;
             }
-            if (!joined) {
-                std::cout << "A player tried to join but the server is full. Connection refused.\n";
-                close(new_socket);
+            config.tick_rate = (int)value;
+        } else if (strcmp(argv[i], "--udp") == 0) {
+            config.udp = true;
+        } else if (strcmp(argv[i], "--view-radius") == 0 && i + 1 < argc) {
+            if (!parse_int(argv[++i], 0, 100000, value)) {
+                std::cerr << "--view-radius must be between 0 (off) and 100000 pixels\n";
+                return false;
             }
+            config.view_radius = (float)value;
+        } else if (strcmp(argv[i], "--max-rewind-ms") == 0 && i + 1 < argc) {
+            if (!parse_int(argv[++i], 0, 1000, value)) {
+                std::cerr << "--max-rewind-ms must be between 0 (off) and 1000\n";
+                return false;
+            }
+            config.max_rewind_ms = (int)value;
+        } else if (strcmp(argv[i], "--rooms") == 0 && i + 1 < argc) {
+            if (!parse_int(argv[++i], 1, MAX_ROOMS, value)) {
+                std::cerr << "--rooms must be between 1 and " << MAX_ROOMS << "\n";
+                return false;
+            }
+            config.rooms = (int)value;
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            if (!parse_int(argv[++i], 1, MAX_WORKERS, value)) {
+                std::cerr << "--workers must be between 1 and " << MAX_WORKERS << "\n";
+                return false;
+            }
+            config.workers = (int)value;
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            if (!parse_int(argv[++i], 1, 65535, value)) {
+                std::cerr << "--metrics-port must be between 1 and 65535\n";
+                return false;
+            }
+            config.metrics_port = (int)value;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            config.record_path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--max-players N] [--tick-rate HZ] [--udp] [--view-radius PX]"
+                      << " [--max-rewind-ms MS] [--rooms N] [--workers N] [--metrics-port PORT] [--record FILE]\n";
+            return false;
         }
+    }
+    return true;
+}
+
+// Each player needs one file descriptor, so lift the soft limit (often 1024) as far as the hard limit allows.
+static void raise_fd_limit(long max_players) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return;
+    rlim_t wanted = (rlim_t)max_players + 64; // headroom for the listeners, epoll and stdio
+    if (limit.rlim_cur >= wanted) return;
+    limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || wanted < limit.rlim_max) ? wanted : limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur < wanted) {
+        std::cerr << "Warning: file descriptor limit is " << limit.rlim_cur
+                  << ", not every one of the " << max_players << " player slots can be filled\n";
+    }
+}
 
-        // Event B: Data from an existing client
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            int sd = client_sockets[i];
-            if (sd > 0 && FD_ISSET(sd, &readfds)) {
-                InputPacket input;
-                ssize_t valread = recv(sd, &input, sizeof(InputPacket), 0);
-
-                if (valread <= 0) {
-                    // 0 means orderly shutdown, -1 means error
-                    struct sockaddr_in client_addr;
-                    socklen_t client_len = sizeof(client_addr);
-                    getpeername(sd, (struct sockaddr*)&client_addr, &client_len);
-                    std::cout << "Host disconnected, ip: \n" << inet_ntoa(client_addr.sin_addr) << std::endl;
-                    std::cout << "Player " << i << " disconnected.\n";
-                    close(sd);
-                    client_sockets[i] = 0;
-                    game_state.players[i].active = 0;
-                } else if (valread < sizeof(InputPacket)) {
-                    // This is a "Partial Read" - Ignore it for now to prevent crashes
-                    std::cout << "Received incomplete packet. Ignoring...\n";
-                } else if (input.type == RESTART_REQ) {
-                    std::cout << "Restart requested by Player " << i << ". Resetting game...\n";
-                    for (int j = 0; j < MAX_PLAYERS; j++) {
-                        game_state.players[j].score = 0;
-                        game_state.players[j].x = 700.0f; // Reset to center
-                        game_state.players[j].y = 450.0f;
-                    }
-                }                
-                else {
-                    if (input.type == INPUT) {// Update server logic based on input
-                        game_state.players[i].x += input.dx * 5.0f; // Speed multiplier
-                        game_state.players[i].y += input.dy * 5.0f;
-
-                        // --- ARENA BOUNDARY CLAMPING ---
-                        const float MAP_WIDTH = 1500.0f;
-                        const float MAP_HEIGHT = 900.0f;
-                        const float MARGIN = 50.0f; // Player radius
-
-                        if (game_state.players[i].x < MARGIN) game_state.players[i].x = MARGIN;
-                        if (game_state.players[i].x > MAP_WIDTH - MARGIN) game_state.players[i].x = MAP_WIDTH - MARGIN;
-                        if (game_state.players[i].y < MARGIN) game_state.players[i].y = MARGIN;
-                        if (game_state.players[i].y > MAP_HEIGHT - MARGIN) game_state.players[i].y = MARGIN;
-
-                        game_state.players[i].rotation = input.rotation;
-                        game_state.players[i].is_attacking = input.attack;
-
-                        // 2. Collision Detection (Only if they are attacking)
-                        if (input.attack) {
-                            float attack_range = 50.0f + (game_state.players[i].score * 6.0f);
-                            
-                            // Calculate where the "newspaper" hits (polar to cartesian)
-                            float hit_x = game_state.players[i].x + cos(input.rotation) * attack_range;
-                            float hit_y = game_state.players[i].y + sin(input.rotation) * attack_range;
-
-                            // Check against all other players
-                            for (int j = 0; j < MAX_PLAYERS; j++) {
-                                if (i == j || !game_state.players[j].active) continue;
+int main(int argc, char* argv[]){
+    ServerConfig config;
+    if (!parse_args(argc, argv, config)) return 1;
 
-                                // Distance formula: sqrt((x2-x1)^2 + (y2-y1)^2)
-                                float dx = hit_x - game_state.players[j].x;
-                                float dy = hit_y - game_state.players[j].y;
-                                float distance = sqrt(dx*dx + dy*dy);
+    signal(SIGPIPE, SIG_IGN); // Ignore SIGPIPE to prevent crashes when sending to disconnected clients
 
-                                if (distance < 50.0f) { // 30.0f is the victim's "hitbox" radius
-                                    // SUCCESSFUL SMACK!
-                                    game_state.players[i].score++; 
-                                    
-                                    // Optional: Respawn victim or just reduce their score
-                                    if(game_state.players[j].score > 0) game_state.players[j].score--;
-                                    
-                                    // Simple knockback: Push the victim away
-                                    game_state.players[j].x += cos(input.rotation) * 20.0f;
-                                    game_state.players[j].y += sin(input.rotation) * 20.0f;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+    // One worker per core by default. More workers than rooms would only accept and pass connections on.
+    int cores = (int)std::thread::hardware_concurrency();
+    if (cores < 1) cores = 1;
+    if (config.workers == 0) config.workers = cores;
+    if (config.workers > config.rooms) config.workers = config.rooms;
+    raise_fd_limit((long)config.rooms * config.max_players + config.workers * (MAX_PENDING + 8));
+
+    // Rooms are dealt out round-robin, so room n and room n + 1 land on different cores
+    std::vector<Room> rooms(config.rooms);
+    std::vector<Worker> workers(config.workers);
+    for (int r = 0; r < config.rooms; r++) {
+        Worker& worker = workers[r % config.workers];
+        rooms[r].init(r + 1, config);
+        if (config.record_path && !rooms[r].recorder.active()) {
+            std::cerr << "Could not create the recording for room " << (r + 1) << ": " << strerror(errno) << "\n";
+            return 1;
         }
+        rooms[r].worker = r % config.workers;
+        rooms[r].local_index = (int)worker.rooms.size();
+        rooms[r].metrics = &worker.metrics;
+        worker.rooms.push_back(&rooms[r]);
+    }
+    for (int w = 0; w < config.workers; w++) {
+        workers[w].index = w;
+        workers[w].config = &config;
+        workers[w].all_rooms = &rooms;
+        workers[w].all_workers = &workers;
+        if (!workers[w].open()) return 1;
+    }
 
-        // 7. Broadcast the updated GameState to everyone
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (client_sockets[i] > 0) {
-                send(client_sockets[i], &game_state, sizeof(GameStatePacket), 0);
-            }
-        }
+    std::cout << "Server listening on port " << SERVER_PORT << " (" << config.rooms << " room(s) of up to "
+              << config.max_players << " players, " << config.workers << " worker thread(s), "
+              << config.tick_rate << " Hz)...\n";
+    if (config.udp) {
+        std::cout << "UDP transport enabled on ports " << SERVER_PORT << "-" << (SERVER_PORT + config.workers - 1) << "/udp\n";
+    }
+    if (config.metrics_port != 0) {
+        if (!start_metrics_server(config.metrics_port, workers, rooms)) return 1;
+        std::cout << "Metrics on http://127.0.0.1:" << config.metrics_port << "/metrics\n";
+    }
+    if (config.record_path) {
+        std::cout << "Recording inputs to " << config.record_path << (config.rooms > 1 ? ".<room>" : "") << "\n";
+    }
+    std::cout.flush();
+    log_start(); // From here on the workers log through the async logger
+
+    // Every worker owns its rooms outright, so there is nothing to lock on the hot path. Pin each one to
+    // its own core so its rooms' data stays in that core's cache.
+    std::vector<std::thread> threads;
+    for (int w = 0; w < config.workers; w++) {
+        threads.push_back(std::thread(&Worker::run, &workers[w]));
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(w % cores, &cpus);
+        int error = pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpus), &cpus);
+        if (error != 0) std::cerr << "Warning: could not pin worker " << w << " to core " << (w % cores) << ": " << strerror(error) << "\n";
     }
+    for (size_t w = 0; w < threads.size(); w++) threads[w].join(); // Workers run until the process is killed
 
     return 0;
-} 
+}
@@ -0,0 +1,183 @@
+#include "metrics.h"
+#include "worker.h"
+#include "room.h"
+#include "log.h"
+#include <string>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+// Appends one sample line: name{labels} value
+static void sample(std::string& out, const char* name, const char* labels, uint64_t value) {
+    char line[256];
+    snprintf(line, sizeof(line), "%s{%s} %llu\n", name, labels, (unsigned long long)value);
+    out += line;
+}
+
+static void header(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += " ";
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += " ";
+    out += type;
+    out += "\n";
+}
+
+// Prometheus histograms are cumulative: each bucket counts every sample up to its bound
+static void histogram(std::string& out, const char* name, const char* help, const std::vector<Worker>& workers,
+                      const Histogram WorkerMetrics::*member) {
+    header(out, name, "histogram", help);
+    char line[256];
+    for (size_t w = 0; w < workers.size(); w++) {
+        const Histogram& h = workers[w].metrics.*member;
+        uint64_t cumulative = 0;
+        for (int k = 0; k <= HISTOGRAM_BUCKETS; k++) {
+            cumulative += h.buckets[k].load(std::memory_order_relaxed);
+            if (k < HISTOGRAM_BUCKETS) {
+                snprintf(line, sizeof(line), "%s_bucket{worker=\"%zu\",le=\"%g\"} %llu\n", name, w, (double)(1ull << k) * 1e-6,
+                         (unsigned long long)cumulative);
+            } else {
+                snprintf(line, sizeof(line), "%s_bucket{worker=\"%zu\",le=\"+Inf\"} %llu\n", name, w, (unsigned long long)cumulative);
+            }
+            out += line;
+        }
+        snprintf(line, sizeof(line), "%s_sum{worker=\"%zu\"} %.9f\n%s_count{worker=\"%zu\"} %llu\n", name, w, h.sum_ns.get() * 1e-9,
+                 name, w, (unsigned long long)h.count.get());
+        out += line;
+    }
+}
+
+static void worker_counter(std::string& out, const char* name, const char* help, const std::vector<Worker>& workers,
+                           const Counter WorkerMetrics::*member) {
+    header(out, name, "counter", help);
+    char labels[32];
+    for (size_t w = 0; w < workers.size(); w++) {
+        snprintf(labels, sizeof(labels), "worker=\"%zu\"", w);
+        sample(out, name, labels, (workers[w].metrics.*member).get());
+    }
+}
+
+static std::string render(const std::vector<Worker>& workers, const std::vector<Room>& rooms) {
+    std::string out;
+    histogram(out, "smack_tick_duration_seconds", "Time to run every room of a worker for one tick timer wakeup.", workers, &WorkerMetrics::tick);
+    histogram(out, "smack_input_duration_seconds", "Time to pick each player's command from its input queue, per room tick.", workers, &WorkerMetrics::input);
+    histogram(out, "smack_simulate_duration_seconds", "Time in simulate_tick() per room tick, collision included.", workers, &WorkerMetrics::simulate);
+    histogram(out, "smack_collision_duration_seconds", "Time in the hit tests per room tick.", workers, &WorkerMetrics::collision);
+    histogram(out, "smack_broadcast_duration_seconds", "Time to encode and send one room's snapshots.", workers, &WorkerMetrics::broadcast);
+
+    worker_counter(out, "smack_received_bytes_total", "Bytes received from clients.", workers, &WorkerMetrics::bytes_in);
+    worker_counter(out, "smack_sent_bytes_total", "Snapshot bytes handed to the kernel.", workers, &WorkerMetrics::bytes_out);
+    worker_counter(out, "smack_inputs_received_total", "Inputs queued for the simulation.", workers, &WorkerMetrics::inputs_received);
+    worker_counter(out, "smack_inputs_dropped_total", "Inputs pushed out of a full input queue.", workers, &WorkerMetrics::inputs_dropped);
+    worker_counter(out, "smack_snapshots_sent_total", "Snapshots sent or queued for sending.", workers, &WorkerMetrics::snapshots_sent);
+    worker_counter(out, "smack_snapshots_dropped_total", "Stale snapshots replaced in a backed-up outbound queue.", workers, &WorkerMetrics::snapshots_dropped);
+    worker_counter(out, "smack_partial_sends_total", "Snapshots the kernel only accepted part of.", workers, &WorkerMetrics::partial_sends);
+    worker_counter(out, "smack_datagrams_rejected_total", "Malformed, misrouted or unauthenticated datagrams.", workers, &WorkerMetrics::datagrams_rejected);
+    worker_counter(out, "smack_datagrams_failed_total", "Snapshot datagrams the kernel refused.", workers, &WorkerMetrics::datagrams_failed);
+    worker_counter(out, "smack_stalled_disconnects_total", "Clients disconnected for not reading their snapshots.", workers, &WorkerMetrics::stalled_disconnects);
+    worker_counter(out, "smack_ticks_skipped_total", "Ticks skipped after the worker fell too far behind.", workers, &WorkerMetrics::ticks_skipped);
+
+    char labels[64];
+    header(out, "smack_room_players", "gauge", "Players in the room.");
+    for (size_t r = 0; r < rooms.size(); r++) {
+        snprintf(labels, sizeof(labels), "room=\"%d\"", rooms[r].number);
+        sample(out, "smack_room_players", labels, (uint64_t)rooms[r].population.load(std::memory_order_relaxed));
+    }
+    header(out, "smack_room_spectators", "gauge", "Spectators watching the room (relays count as one).");
+    for (size_t r = 0; r < rooms.size(); r++) {
+        snprintf(labels, sizeof(labels), "room=\"%d\"", rooms[r].number);
+        sample(out, "smack_room_spectators", labels, rooms[r].stats.spectators.get());
+    }
+    header(out, "smack_room_outbound_queue_bytes", "gauge", "Snapshot bytes waiting for client sockets to drain.");
+    for (size_t r = 0; r < rooms.size(); r++) {
+        snprintf(labels, sizeof(labels), "room=\"%d\"", rooms[r].number);
+        sample(out, "smack_room_outbound_queue_bytes", labels, rooms[r].stats.outbound_queued_bytes.get());
+    }
+    header(out, "smack_room_input_queue_depth", "gauge", "Inputs waiting for a future tick.");
+    for (size_t r = 0; r < rooms.size(); r++) {
+        snprintf(labels, sizeof(labels), "room=\"%d\"", rooms[r].number);
+        sample(out, "smack_room_input_queue_depth", labels, rooms[r].stats.input_queue_depth.get());
+    }
+
+    // Per client, for slots that have seen traffic since they were last handed out
+    header(out, "smack_client_received_bytes_total", "counter", "Bytes received from the player in this slot.");
+    for (size_t r = 0; r < rooms.size(); r++) {
+        for (int i = 0; i < rooms[r].config->max_players; i++) {
+            uint64_t value = rooms[r].stats.clients[i].bytes_in.get();
+            if (value == 0) continue;
+            snprintf(labels, sizeof(labels), "room=\"%d\",player=\"%d\"", rooms[r].number, i);
+            sample(out, "smack_client_received_bytes_total", labels, value);
+        }
+    }
+    header(out, "smack_client_sent_bytes_total", "counter", "Snapshot bytes sent to the player in this slot.");
+    for (size_t r = 0; r < rooms.size(); r++) {
+        for (int i = 0; i < rooms[r].config->max_players; i++) {
+            uint64_t value = rooms[r].stats.clients[i].bytes_out.get();
+            if (value == 0) continue;
+            snprintf(labels, sizeof(labels), "room=\"%d\",player=\"%d\"", rooms[r].number, i);
+            sample(out, "smack_client_sent_bytes_total", labels, value);
+        }
+    }
+
+    header(out, "smack_log_dropped_total", "counter", "Log lines dropped because the log queue was full.");
+    out += "smack_log_dropped_total ";
+    out += std::to_string(log_dropped());
+    out += "\n";
+    return out;
+}
+
+// A deliberately tiny HTTP/1.0 server: one scrape at a time, whatever the path, then close. It runs on its
+// own thread and only reads atomics, so a slow scraper never touches a worker.
+static void serve(int listen_fd, const std::vector<Worker>* workers, const std::vector<Room>* rooms) {
+    while (true) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR) log_line("metrics accept: %s", strerror(errno));
+            continue;
+        }
+        timeval timeout{1, 0}; // Don't let a silent client hold the endpoint
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        char request[1024];
+        if (recv(fd, request, sizeof(request), 0) > 0) { // We only need to know a request arrived
+            std::string body = render(*workers, *rooms);
+            std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                                   std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+            size_t sent = 0;
+            while (sent < response.size()) {
+                ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) break;
+                sent += (size_t)n;
+            }
+        }
+        close(fd);
+    }
+}
+
+bool start_metrics_server(int port, const std::vector<Worker>& workers, const std::vector<Room>& rooms) {
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        perror("metrics socket");
+        return false;
+    }
+    int opt = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // Local only: the numbers aren't for the players
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+        fprintf(stderr, "Metrics endpoint could not bind 127.0.0.1:%d: %s\n", port, strerror(errno));
+        close(listen_fd);
+        return false;
+    }
+    std::thread(serve, listen_fd, &workers, &rooms).detach();
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef METRICS_H // Include guard to prevent multiple inclusions
+#define METRICS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// --- Metrics ---
+//
+// Counters and histograms the worker threads bump on the hot path with relaxed atomic adds: no locks, and
+// no sharing between workers (each has its own WorkerMetrics, each room its own RoomMetrics), so an update
+// costs about as much as a plain increment. The metrics thread reads them whenever it is scraped and
+// renders Prometheus' text format on 127.0.0.1:--metrics-port.
+
+struct Counter {
+    std::atomic<uint64_t> value{0};
+    void add(uint64_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// A value that is overwritten rather than accumulated (queue depths).
+struct Gauge {
+    std::atomic<uint64_t> value{0};
+    void set(uint64_t n) { value.store(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Durations in power-of-two buckets: bucket k counts samples up to 2^k microseconds, the last one
+// everything slower. Picking the bucket is a count-leading-zeros, not a search.
+static const int HISTOGRAM_BUCKETS = 24; // 1 us .. ~4 s, then +Inf
+
+struct Histogram {
+    std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS + 1] = {};
+    Counter count;
+    Counter sum_ns;
+
+    void observe(uint64_t ns) {
+        uint64_t us = (ns + 999) / 1000;
+        int k = us <= 1 ? 0 : 64 - __builtin_clzll(us - 1); // Smallest k with us <= 2^k
+        if (k > HISTOGRAM_BUCKETS) k = HISTOGRAM_BUCKETS;
+        buckets[k].fetch_add(1, std::memory_order_relaxed);
+        count.add(1);
+        sum_ns.add(ns);
+    }
+};
+
+// Per worker thread. One "tick" is one wakeup of the tick timer: every room's catch-up ticks and broadcast.
+struct WorkerMetrics {
+    Histogram tick;      // The whole tick, all rooms
+    Histogram input;     // Picking each player's command from its input queue
+    Histogram simulate;  // simulate_tick(): movement and combat (collision included)
+    Histogram collision; // The hit tests alone
+    Histogram broadcast; // Snapshot encoding and sending
+
+    Counter bytes_in;            // TCP and UDP payload received from clients
+    Counter bytes_out;           // Snapshot bytes handed to the kernel
+    Counter inputs_received;     // Inputs queued for the simulation
+    Counter inputs_dropped;      // Inputs pushed out of a full queue before their tick came
+    Counter snapshots_sent;
+    Counter snapshots_dropped;   // Replaced in a backed-up outbound queue before any of it went out
+    Counter partial_sends;       // Snapshots the kernel only took part of
+    Counter datagrams_rejected;  // Malformed, for another worker, or with a bad token
+    Counter datagrams_failed;    // Snapshot datagrams the kernel refused to send
+    Counter stalled_disconnects; // Clients dropped for not reading their snapshots
+    Counter ticks_skipped;       // Ticks given up on after a stall
+};
+
+// Traffic of whoever currently holds one player slot (reset when the slot changes hands).
+struct ClientTraffic {
+    Counter bytes_in;
+    Counter bytes_out;
+};
+
+struct RoomMetrics {
+    Gauge outbound_queued_bytes; // Summed over clients at the last broadcast
+    Gauge input_queue_depth;     // Inputs waiting for a future tick, summed over clients
+    Gauge spectators;            // Spectator places in use
+    std::unique_ptr<ClientTraffic[]> clients; // Indexed by player id
+
+    void init(int max_players) { clients.reset(new ClientTraffic[max_players]); }
+};
+
+struct Worker;
+struct Room;
+
+// Serve the metrics of every worker and room on 127.0.0.1:port from a background thread.
+// Returns false if the port can't be bound.
+bool start_metrics_server(int port, const std::vector<Worker>& workers, const std::vector<Room>& rooms);
+
+#endif // METRICS_H
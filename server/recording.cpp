@@ -0,0 +1,155 @@
+#include "recording.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h> // write(), close()
+
+static const uint64_t FNV_OFFSET = 1469598103934665603ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t k = 0; k < length; k++) hash = (hash ^ bytes[k]) * FNV_PRIME;
+    return hash;
+}
+
+uint64_t world_hash(const World& world) {
+    uint64_t hash = FNV_OFFSET;
+    for (int i = 0; i < world.capacity; i++) {
+        if (!world.active[i]) continue;
+        uint16_t id = (uint16_t)i;
+        hash = fnv1a(hash, &id, sizeof(id));
+        hash = fnv1a(hash, &world.x[i], sizeof(float)); // Raw bits: any difference at all is a mismatch
+        hash = fnv1a(hash, &world.y[i], sizeof(float));
+        hash = fnv1a(hash, &world.rotation[i], sizeof(float));
+        hash = fnv1a(hash, &world.score[i], sizeof(uint32_t));
+        hash = fnv1a(hash, &world.attacking[i], sizeof(uint8_t));
+    }
+    return hash;
+}
+
+bool Recorder::open(const char* path, const RecordingHeader& header) {
+    fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    buffer.reserve(RECORDING_FLUSH_BYTES * 2);
+    flush_ticks = header.tick_rate;
+    append(&header, sizeof(header));
+    flush();
+    return fd >= 0;
+}
+
+void Recorder::append(const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    buffer.insert(buffer.end(), bytes, bytes + length);
+}
+
+void Recorder::flush() {
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t n = ::write(fd, buffer.data() + written, buffer.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) { // Disk full or similar: stop recording rather than write a log with holes in it
+            close(fd);
+            fd = -1;
+            break;
+        }
+        written += (size_t)n;
+    }
+    buffer.clear();
+    ticks_since_flush = 0;
+}
+
+void Recorder::join(int id) {
+    if (fd < 0) return;
+    uint8_t record[3] = {REC_JOIN};
+    uint16_t player = (uint16_t)id;
+    memcpy(record + 1, &player, sizeof(player));
+    append(record, sizeof(record));
+}
+
+void Recorder::leave(int id) {
+    if (fd < 0) return;
+    uint8_t record[3] = {REC_LEAVE};
+    uint16_t player = (uint16_t)id;
+    memcpy(record + 1, &player, sizeof(player));
+    append(record, sizeof(record));
+}
+
+void Recorder::restart() {
+    if (fd < 0) return;
+    uint8_t type = REC_RESTART;
+    append(&type, sizeof(type));
+}
+
+void Recorder::tick(uint32_t tick, const std::vector<PlayerCommand>& commands, const World& world) {
+    if (fd < 0) return;
+    uint8_t type = REC_TICK;
+    append(&type, sizeof(type));
+    append(&tick, sizeof(tick));
+
+    // The count goes in front of the commands, so reserve it and fill it in once we know it
+    size_t count_pos = buffer.size();
+    uint16_t count = 0;
+    append(&count, sizeof(count));
+    for (int i = 0; i < world.capacity; i++) {
+        const PlayerCommand& cmd = commands[i];
+        if (!world.active[i] || !cmd.present) continue;
+        RecordedCommand recorded;
+        recorded.id = (uint16_t)i;
+        recorded.dx = cmd.dx;
+        recorded.dy = cmd.dy;
+        recorded.rotation = cmd.rotation;
+        recorded.attack = cmd.attack;
+        recorded.rewind_tick = cmd.rewind_tick;
+        append(&recorded, sizeof(recorded));
+        count++;
+    }
+    memcpy(buffer.data() + count_pos, &count, sizeof(count));
+
+    uint64_t hash = world_hash(world);
+    append(&hash, sizeof(hash));
+
+    if (buffer.size() >= RECORDING_FLUSH_BYTES || ++ticks_since_flush >= flush_ticks) flush();
+}
+
+bool RecordingReader::open(const uint8_t* file, size_t length, RecordingHeader& header) {
+    if (length < sizeof(RecordingHeader)) return false;
+    memcpy(&header, file, sizeof(header));
+    if (memcmp(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0 || header.version != RECORDING_VERSION) return false;
+    if (header.tick_rate == 0 || header.max_players == 0 || header.max_players > MAX_PLAYERS_LIMIT) return false;
+    data = file;
+    size = length;
+    pos = sizeof(RecordingHeader);
+    return true;
+}
+
+RecordingReader::Result RecordingReader::next(RecordType& type, uint16_t& id, uint32_t& tick,
+                                              const RecordedCommand*& commands, uint16_t& count, uint64_t& hash) {
+    if (pos == size) return END;
+    type = (RecordType)data[pos];
+    size_t start = pos + 1;
+    switch (type) {
+    case REC_JOIN:
+    case REC_LEAVE:
+        if (size - start < sizeof(uint16_t)) return TRUNCATED;
+        memcpy(&id, data + start, sizeof(id));
+        pos = start + sizeof(id);
+        return RECORD;
+    case REC_RESTART:
+        pos = start;
+        return RECORD;
+    case REC_TICK: {
+        size_t fixed = sizeof(uint32_t) + sizeof(uint16_t);
+        if (size - start < fixed) return TRUNCATED;
+        memcpy(&tick, data + start, sizeof(tick));
+        memcpy(&count, data + start + sizeof(tick), sizeof(count));
+        size_t body = fixed + (size_t)count * sizeof(RecordedCommand) + sizeof(uint64_t);
+        if (size - start < body) return TRUNCATED;
+        commands = (const RecordedCommand*)(data + start + fixed); // Packed struct, so no alignment issue
+        memcpy(&hash, data + start + body - sizeof(uint64_t), sizeof(hash));
+        pos = start + body;
+        return RECORD;
+    }
+    }
+    return TRUNCATED; // Unknown type: nothing after it can be trusted
+}
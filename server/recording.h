@@ -0,0 +1,102 @@
+#ifndef RECORDING_H // Include guard to prevent multiple inclusions
+#define RECORDING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "world.h"
+
+// --- Input recording ---
+//
+// With --record, each room appends everything its simulation depends on to a binary log: joins, leaves,
+// restarts, and every tick's commands (the inputs the room actually applied, after queueing and late-input
+// holds), followed by a hash of the world after that tick. simulate_tick() is a pure function of those, so
+// replay_app can memory-map the log, run the same ticks headless as fast as the CPU allows, and check each
+// hash - a real workload for benchmarking the simulation, and proof that an optimization didn't change
+// who hit whom.
+//
+// File = RecordingHeader, then records back to back. Each record is a uint8_t RecordType followed by:
+//   REC_JOIN / REC_LEAVE   uint16_t player id (World::spawn / World::despawn)
+//   REC_RESTART            nothing (World::reset_round)
+//   REC_TICK               uint32_t tick number after the step, uint16_t count, `count` RecordedCommands
+//                          (players with no command this tick are left out), uint64_t world_hash()
+
+static const char RECORDING_MAGIC[4] = {'S', 'M', 'K', 'R'};
+static const uint16_t RECORDING_VERSION = 1;
+static const size_t RECORDING_FLUSH_BYTES = 64 * 1024; // Buffered before each write()
+
+enum RecordType : uint8_t {
+    REC_JOIN = 0,
+    REC_LEAVE = 1,
+    REC_RESTART = 2,
+    REC_TICK = 3
+};
+
+#pragma pack(push, 1)
+struct RecordingHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t tick_rate;        // dt = 1 / tick_rate
+    uint32_t max_players;      // World capacity
+    uint32_t max_rewind_ticks; // Lag compensation history depth (0 = off)
+    uint16_t room;
+};
+
+// One PlayerCommand, with full-precision floats so the replay computes bit-identical results.
+struct RecordedCommand {
+    uint16_t id;
+    float dx;
+    float dy;
+    float rotation;
+    uint8_t attack;
+    uint32_t rewind_tick;
+};
+#pragma pack(pop)
+
+// FNV-1a over every active player's id, position, rotation, score and attack flag (the replicated state).
+uint64_t world_hash(const World& world);
+
+// Appends one room's records to a file. Records are collected in memory and written in large blocks, so
+// the tick only pays for a memcpy; the write() itself lands in the page cache. Not thread-safe: a room's
+// recorder is only used by the room's own worker.
+struct Recorder {
+    int fd = -1; // -1 = not recording
+    std::vector<uint8_t> buffer;
+    uint32_t ticks_since_flush = 0;
+    uint32_t flush_ticks = 0; // Write at least this often (about once a second), so a killed server loses little
+
+    // Create the file and write its header. Returns false (and records nothing) if it can't be created.
+    bool open(const char* path, const RecordingHeader& header);
+    bool active() const { return fd >= 0; }
+
+    void join(int id);
+    void leave(int id);
+    void restart();
+    void tick(uint32_t tick, const std::vector<PlayerCommand>& commands, const World& world);
+
+private:
+    void append(const void* data, size_t length);
+    void flush();
+};
+
+// Reads a recording in place. A memory-mapped file is parsed record by record with no copies; records
+// hand out pointers into the mapping.
+struct RecordingReader {
+    const uint8_t* data = NULL;
+    size_t size = 0;
+    size_t pos = 0;
+
+    // Point at a mapped file. Returns false if it doesn't start with a header this build understands.
+    bool open(const uint8_t* file, size_t length, RecordingHeader& header);
+    void rewind() { pos = sizeof(RecordingHeader); }
+
+    enum Result {
+        RECORD,    // type and the matching fields below describe the next record
+        END,       // Clean end of the log
+        TRUNCATED  // The log stops mid-record (the server was killed while writing)
+    };
+    Result next(RecordType& type, uint16_t& id, uint32_t& tick, const RecordedCommand*& commands,
+                uint16_t& count, uint64_t& hash);
+};
+
+#endif // RECORDING_H
@@ -0,0 +1,557 @@
+#include "room.h"
+#include "../common/clock.h"
+#include "log.h"
+#include <string.h>
+#include <string>
+#include <errno.h>
+#include <unistd.h> // close()
+#include <arpa/inet.h> // inet_ntoa()
+#include <sys/socket.h>
+#include <sys/uio.h> // iovec for sendmsg(): datagram header + shared snapshot payload without a copy
+
+void Room::init(int room_number, const ServerConfig& server_config) {
+    number = room_number;
+    config = &server_config;
+    slots.resize(config->max_players);
+    free_slots.reserve(config->max_players);
+    for (int i = config->max_players - 1; i >= 0; i--) free_slots.push_back((uint16_t)i); // lowest id on top
+    max_rewind_ticks = (uint32_t)(((long)config->max_rewind_ms * config->tick_rate + 999) / 1000);
+    world.init(config->max_players, max_rewind_ticks ? max_rewind_ticks + 1 : 0);
+    max_stall_ticks = (uint32_t)(((long)SEND_STALL_MS * config->tick_rate + 999) / 1000);
+    commands.resize(config->max_players);
+    spectators.resize(MAX_SPECTATORS);
+    for (int k = MAX_SPECTATORS - 1; k >= 0; k--) free_spectators.push_back((uint16_t)k);
+    stats.init(config->max_players);
+
+    if (config->record_path) {
+        std::string path = config->record_path;
+        if (config->rooms > 1) path += "." + std::to_string(number);
+        RecordingHeader header;
+        memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+        header.version = RECORDING_VERSION;
+        header.tick_rate = (uint16_t)config->tick_rate;
+        header.max_players = (uint32_t)config->max_players;
+        header.max_rewind_ticks = max_rewind_ticks;
+        header.room = (uint16_t)number;
+        recorder.open(path.c_str(), header); // main() checks recorder.active()
+    }
+}
+
+int Room::admit(int fd, uint32_t udp_token, uint16_t udp_port) {
+    if (free_slots.empty()) return -1;
+    uint16_t i = free_slots.back();
+    free_slots.pop_back();
+
+    ClientSlot& slot = slots[i];
+    slot.fd = fd;
+    if (slot.rx.data.empty()) slot.rx.data.resize(CLIENT_RECV_BUFFER);
+    slot.rx.clear();
+    slot.inputs.clear();
+    slot.last_seq = 0;
+    slot.has_input = false;
+    slot.applied_seq = 0;
+    slot.starved_ticks = 0;
+    slot.acked_snapshot = 0; // First snapshot is a full one
+    slot.tx.clear();
+    slot.udp_bound = false;
+    slot.input_acks = AckTracker();
+    slot.interest.clear(); // Don't rebuild baselines from the previous occupant's views
+    slot.udp_token = udp_token;
+    stats.clients[i].bytes_in.value.store(0, std::memory_order_relaxed);
+    stats.clients[i].bytes_out.value.store(0, std::memory_order_relaxed);
+    population.fetch_add(1, std::memory_order_relaxed);
+
+    // 1. Prepare and send Welcome Packet
+    WelcomePacket welcome;
+    welcome.assigned_id = i;
+    welcome.tick_rate = (uint16_t)config->tick_rate;
+    welcome.udp_token = udp_token;
+    welcome.room = (uint16_t)number;
+    welcome.udp_port = udp_port;
+    size_t written = 0;
+    send_control(fd, slot.tx, JOIN, welcome, written); // A socket error shows up on the next read and drops the slot
+    stats.clients[i].bytes_out.add(written);
+
+    // 2. Initialize player state
+    world.spawn(i);
+    recorder.join(i);
+
+    log_line("Room %d: Player %d joined!", number, i);
+    return i;
+}
+
+// Free a player's slot. Closing the socket also removes it from the epoll set.
+void Room::disconnect(int i) {
+    ClientSlot& slot = slots[i];
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    getpeername(slot.fd, (struct sockaddr*)&client_addr, &client_len);
+    char address[INET_ADDRSTRLEN] = "?"; // inet_ntoa()'s shared buffer isn't safe with several workers
+    inet_ntop(AF_INET, &client_addr.sin_addr, address, sizeof(address));
+    log_line("Host disconnected, ip: %s", address);
+    log_line("Room %d: Player %d disconnected.", number, i);
+    close(slot.fd);
+    slot.fd = -1;
+    slot.inputs.clear();
+    slot.tx.clear();
+    world.despawn(i);
+    recorder.leave(i);
+    free_slots.push_back((uint16_t)i);
+    population.fetch_sub(1, std::memory_order_relaxed);
+}
+
+int Room::admit_spectator(int fd) {
+    if (free_spectators.empty()) return -1;
+    uint16_t k = free_spectators.back();
+    free_spectators.pop_back();
+
+    SpectatorSlot& spectator = spectators[k];
+    spectator.fd = fd;
+    if (spectator.rx.data.empty()) spectator.rx.data.resize(CLIENT_RECV_BUFFER);
+    spectator.rx.clear();
+    spectator.acked_snapshot = 0; // First snapshot is a full one
+    spectator.tx.clear();
+    stats.spectators.set(MAX_SPECTATORS - free_spectators.size());
+
+    WelcomePacket welcome;
+    welcome.assigned_id = SPECTATOR_ID;
+    welcome.tick_rate = (uint16_t)config->tick_rate;
+    welcome.udp_token = 0;
+    welcome.room = (uint16_t)number;
+    welcome.udp_port = 0;
+    size_t written = 0;
+    send_control(fd, spectator.tx, JOIN, welcome, written); // Likewise
+
+    log_line("Room %d: Spectator %d started watching", number, k);
+    return k;
+}
+
+void Room::drop_spectator(int k) {
+    SpectatorSlot& spectator = spectators[k];
+    log_line("Room %d: Spectator %d left", number, k);
+    close(spectator.fd);
+    spectator.fd = -1;
+    spectator.tx.clear();
+    free_spectators.push_back((uint16_t)k);
+    stats.spectators.set(MAX_SPECTATORS - free_spectators.size());
+}
+
+// Read as much as the kernel has per recv() and then parse every complete frame in place.
+// Inputs are only queued here; the simulation consumes them on the tick.
+void Room::on_readable(int i) {
+    ClientSlot& slot = slots[i];
+    while (slot.fd >= 0) {
+        ssize_t valread = slot.rx.recv_from(slot.fd);
+
+        if (valread < 0 && errno == EINTR) continue;
+        if (valread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break; // Nothing left to read
+        if (valread <= 0) {
+            // 0 means orderly shutdown, -1 means error
+            disconnect(i);
+            break;
+        }
+        metrics->bytes_in.add((uint64_t)valread);
+        stats.clients[i].bytes_in.add((uint64_t)valread);
+
+        FrameHeader header;
+        const uint8_t* payload = NULL;
+        StreamBuffer::Result result;
+        while ((result = slot.rx.next_frame(header, payload)) == StreamBuffer::FRAME) {
+            if (header.type == RESTART_REQ) {
+                log_line("Room %d: Restart requested by Player %d. Resetting game...", number, i);
+                restart_requested = true;
+            } else if (header.type == INPUT) {
+                InputPacket input;
+                if (!wire::decode(payload, header.length, input)) continue;
+                if (input.ack > slot.acked_snapshot && input.ack <= tick) slot.acked_snapshot = input.ack;
+                slot.input_acks.received(input.seq);
+                if (input.seq <= slot.last_seq) continue; // Duplicate or out of date (clients start at 1)
+                slot.last_seq = input.seq;
+                if (!slot.inputs.push(input)) metrics->inputs_dropped.add(1);
+                metrics->inputs_received.add(1);
+            }
+            // Unknown frame types are skipped: the length tells us where the next one starts
+        }
+        if (result == StreamBuffer::BAD_FRAME) {
+            log_line("Room %d: Player %d sent an oversized frame (%u bytes). Dropping them.", number, i, header.length);
+            disconnect(i);
+        }
+    }
+}
+
+void Room::on_datagram(const DatagramHeader& dh, const uint8_t* body, size_t length, const sockaddr_in& from) {
+    if (dh.id >= config->max_players || dh.type != INPUT) {
+        metrics->datagrams_rejected.add(1);
+        return;
+    }
+    ClientSlot& slot = slots[dh.id];
+    if (slot.fd < 0 || slot.udp_token == 0 || dh.token != slot.udp_token) { // Spoofed or stale
+        metrics->datagrams_rejected.add(1);
+        return;
+    }
+    metrics->bytes_in.add(DATAGRAM_HEADER_SIZE + length);
+    stats.clients[dh.id].bytes_in.add(DATAGRAM_HEADER_SIZE + length);
+
+    if (!slot.udp_bound || slot.udp_addr.sin_addr.s_addr != from.sin_addr.s_addr || slot.udp_addr.sin_port != from.sin_port) {
+        slot.udp_addr = from; // First datagram, or the client's NAT mapping changed
+        if (!slot.udp_bound) log_line("Room %d: Player %d switched to UDP", number, dh.id);
+        slot.udp_bound = true;
+    }
+    slot.input_acks.received(dh.seq);
+    if (dh.ack > slot.acked_snapshot && dh.ack <= tick) slot.acked_snapshot = dh.ack;
+
+    // Redundant copies of inputs we already queued are dropped by the sequence check
+    size_t stride = input_batch_stride(body, length);
+    if (stride == 0) {
+        metrics->datagrams_rejected.add(1);
+        return;
+    }
+    uint8_t count = body[0];
+    for (int k = 0; k < count; k++) {
+        InputPacket input;
+        if (!wire::decode(body + 1 + k * stride, stride, input)) {
+            metrics->datagrams_rejected.add(1);
+            return;
+        }
+        if (input.seq <= slot.last_seq) continue;
+        slot.last_seq = input.seq;
+        if (!slot.inputs.push(input)) metrics->inputs_dropped.add(1);
+        metrics->inputs_received.add(1);
+    }
+}
+
+void Room::on_writable(int i) {
+    ClientSlot& slot = slots[i];
+    size_t written = 0;
+    StreamResult result = flush_stream(slot.fd, slot.tx, written);
+    stats.clients[i].bytes_out.add(written);
+    if (result == STREAM_STALLED) log_line("Room %d: Player %d stopped reading snapshots. Dropping them.", number, i);
+    if (result != STREAM_OK) disconnect(i);
+}
+
+void Room::on_spectator_writable(int k) {
+    SpectatorSlot& spectator = spectators[k];
+    size_t written = 0;
+    if (flush_stream(spectator.fd, spectator.tx, written) != STREAM_OK) drop_spectator(k);
+}
+
+// Spectators only ever send acks; they can't restart the round or move anyone.
+void Room::on_spectator_readable(int k) {
+    SpectatorSlot& spectator = spectators[k];
+    while (spectator.fd >= 0) {
+        ssize_t valread = spectator.rx.recv_from(spectator.fd);
+        if (valread < 0 && errno == EINTR) continue;
+        if (valread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (valread <= 0) {
+            drop_spectator(k);
+            break;
+        }
+        metrics->bytes_in.add((uint64_t)valread);
+
+        FrameHeader header;
+        const uint8_t* payload = NULL;
+        StreamBuffer::Result result;
+        while ((result = spectator.rx.next_frame(header, payload)) == StreamBuffer::FRAME) {
+            AckPacket ack;
+            if (header.type != ACK || !wire::decode(payload, header.length, ack)) continue;
+            if (ack.ack > spectator.acked_snapshot && ack.ack <= tick) spectator.acked_snapshot = ack.ack;
+        }
+        if (result == StreamBuffer::BAD_FRAME) drop_spectator(k);
+    }
+}
+
+Room::StreamResult Room::flush_stream(int fd, OutboundQueue& out, size_t& written) {
+    while (!out.empty()) {
+        ssize_t n = send(fd, out.bytes.data() + out.sent, out.bytes.size() - out.sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { // Full again; wait for the next EPOLLOUT
+            return stalled(out) ? STREAM_STALLED : STREAM_OK;
+        }
+        if (n < 0) return STREAM_CLOSED;
+        out.sent += (size_t)n;
+        out.last_progress = tick;
+        written += (size_t)n;
+        metrics->bytes_out.add((uint64_t)n);
+        if (out.sent > out.snapshot_start) out.has_unsent_snapshot = false; // Started: it must now go out whole
+    }
+    out.clear();
+    return STREAM_OK;
+}
+
+bool Room::stalled(const OutboundQueue& out) {
+    if (tick - out.last_progress < max_stall_ticks) return false;
+    metrics->stalled_disconnects.add(1);
+    return true;
+}
+
+// Append every byte of parts[] past the first `skip` to the queue.
+static void append_parts(OutboundQueue& out, const iovec* parts, int count, size_t skip) {
+    for (int k = 0; k < count; k++) {
+        const uint8_t* base = (const uint8_t*)parts[k].iov_base;
+        size_t length = parts[k].iov_len;
+        if (skip >= length) {
+            skip -= length;
+            continue;
+        }
+        out.bytes.insert(out.bytes.end(), base + skip, base + length);
+        skip = 0;
+    }
+}
+
+Room::StreamResult Room::send_stream(int fd, OutboundQueue& out, const iovec* parts, int count, size_t& written) {
+    written = 0;
+    if (out.empty()) {
+        // Usual case: straight into the socket buffer with one gathering syscall
+        msghdr msg{};
+        msg.msg_iov = (iovec*)parts;
+        msg.msg_iovlen = count;
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return STREAM_CLOSED;
+        written = n > 0 ? (size_t)n : 0;
+        size_t total = 0;
+        for (int k = 0; k < count; k++) total += parts[k].iov_len;
+        metrics->bytes_out.add(written);
+        if (written == total) return STREAM_OK;
+        metrics->partial_sends.add(1);
+
+        // Short write: keep the rest for EPOLLOUT. A partly sent frame has to be finished, or the stream breaks.
+        out.clear();
+        append_parts(out, parts, count, written);
+        out.snapshot_start = 0;
+        out.has_unsent_snapshot = written == 0;
+        out.last_progress = tick;
+        return STREAM_OK;
+    }
+
+    // Still backed up from an earlier tick
+    if (stalled(out)) return STREAM_STALLED;
+    if (out.has_unsent_snapshot) { // Stale: the new one supersedes it
+        out.bytes.resize(out.snapshot_start);
+        metrics->snapshots_dropped.add(1);
+    }
+    if (out.sent > 0) {
+        out.bytes.erase(out.bytes.begin(), out.bytes.begin() + out.sent);
+        out.sent = 0;
+    }
+    out.snapshot_start = out.bytes.size();
+    out.has_unsent_snapshot = true;
+    append_parts(out, parts, count, 0);
+    return STREAM_OK;
+}
+
+template <class Packet>
+Room::StreamResult Room::send_control(int fd, OutboundQueue& out, PacketType type, const Packet& packet, size_t& written) {
+    uint8_t frame[FRAME_HEADER_SIZE + wire::Size<Packet>::value];
+    write_frame_header(frame, type, (uint32_t)wire::Size<Packet>::value);
+    wire::encode_at<FRAME_HEADER_SIZE>(frame, packet);
+    iovec part = {frame, sizeof(frame)};
+    StreamResult result = send_stream(fd, out, &part, 1, written);
+    out.has_unsent_snapshot = false; // Queued, it has to arrive: the next snapshot goes in behind it
+    return result;
+}
+
+// Pick each connected player's command for this tick. Each player consumes at most one queued input, so a
+// client that sends faster than the tick rate only fills its queue instead of moving faster.
+// `tick` is the last completed tick: the newest one the position history has.
+static void gather_commands(std::vector<ClientSlot>& slots, std::vector<PlayerCommand>& commands, uint32_t tick, uint32_t max_rewind_ticks) {
+    for (size_t i = 0; i < slots.size(); i++) {
+        ClientSlot& slot = slots[i];
+        PlayerCommand& cmd = commands[i];
+        cmd.present = 0;
+        if (slot.fd < 0) continue;
+
+        InputPacket input;
+        if (slot.inputs.pop(input)) {
+            slot.last_input = input;
+            slot.has_input = true;
+            slot.starved_ticks = 0;
+        } else if (slot.has_input && slot.starved_ticks < INPUT_HOLD_TICKS) {
+            // Late packet: keep doing what they were doing so movement doesn't stutter
+            input = slot.last_input;
+            slot.starved_ticks++;
+        } else {
+            continue; // Idle: nothing to apply this tick
+        }
+        slot.applied_seq = slot.last_input.seq; // Unchanged while holding a late client's last input
+        cmd.present = 1;
+        cmd.dx = input.dx;
+        cmd.dy = input.dy;
+        cmd.rotation = input.rotation;
+        cmd.attack = input.attack;
+
+        // Rewind to the tick nearest to what the client was drawing (a held input has aged by the ticks
+        // it was held for), never into the future and never further back than the cap
+        cmd.rewind_tick = 0;
+        if (max_rewind_ticks > 0 && input.view_tick != 0) {
+            uint32_t view = input.view_tick + (input.view_fraction >= 128 ? 1 : 0) + slot.starved_ticks;
+            if (view <= tick) cmd.rewind_tick = tick - view > max_rewind_ticks ? tick - max_rewind_ticks : view;
+        }
+    }
+}
+
+void Room::run_tick(float dt) {
+    if (restart_requested) {
+        world.reset_round();
+        recorder.restart();
+        restart_requested = false;
+    }
+    uint64_t start = monotonic_ns();
+    gather_commands(slots, commands, tick, max_rewind_ticks);
+    uint64_t gathered = monotonic_ns();
+    move_players(world, commands, dt); // simulate_tick(), split to time the hit tests on their own
+    uint64_t moved = monotonic_ns();
+    resolve_attacks(world, commands);
+    uint64_t simulated = monotonic_ns();
+    metrics->input.observe(gathered - start);
+    metrics->simulate.observe(simulated - gathered);
+    metrics->collision.observe(simulated - moved);
+    tick++;
+    if (max_rewind_ticks > 0) world.history.record(tick, world);
+    recorder.tick(tick, commands, world);
+}
+
+EncodedSnapshot& Room::encoding(const Snapshot& source, const Snapshot* baseline, size_t& encoded_count) {
+    uint32_t baseline_seq = baseline ? baseline->seq : 0;
+    for (size_t k = 0; k < encoded_count; k++) {
+        if (encoded[k].baseline == baseline_seq) return encoded[k];
+    }
+    if (encoded_count == encoded.size()) encoded.push_back(EncodedSnapshot());
+    EncodedSnapshot& snapshot = encoded[encoded_count++];
+    snapshot.baseline = baseline_seq;
+    snapshot.frame.resize(FRAME_HEADER_SIZE);
+    encode_snapshot(source, baseline, snapshot.frame);
+    write_frame_header(snapshot.frame.data(), STATE_UPDATE, (uint32_t)(snapshot.frame.size() - FRAME_HEADER_SIZE));
+    return snapshot;
+}
+
+// Spectators have no inputs for the state to include, so the cached frame goes out as it is.
+void Room::send_to_spectators(const Snapshot& current, size_t& encoded_count, uint64_t& queued_bytes) {
+    for (int k = 0; k < MAX_SPECTATORS; k++) {
+        SpectatorSlot& spectator = spectators[k];
+        if (spectator.fd < 0) continue;
+        EncodedSnapshot& snapshot = encoding(current, history.find(spectator.acked_snapshot), encoded_count);
+        iovec part;
+        part.iov_base = snapshot.frame.data();
+        part.iov_len = snapshot.frame.size();
+        size_t written = 0;
+        StreamResult result = send_stream(spectator.fd, spectator.tx, &part, 1, written);
+        if (result != STREAM_OK) {
+            drop_spectator(k);
+            continue;
+        }
+        queued_bytes += spectator.tx.bytes.size() - spectator.tx.sent;
+        metrics->snapshots_sent.add(1);
+    }
+}
+
+// Send the updated GameState to everyone, once per batch of ticks. Each client gets a delta against
+// the last snapshot it acknowledged (or a full snapshot if that one has aged out of the history).
+void Room::broadcast(int udp_fd) {
+    if (population.load(std::memory_order_relaxed) == 0) return;
+    uint64_t start = monotonic_ns();
+    Snapshot& current = history.insert(tick);
+    current.server_time = (uint32_t)monotonic_us();
+    for (int i = 0; i < config->max_players; i++) {
+        if (world.active[i]) current.entities.push_back(quantize(world.player_state(i)));
+    }
+
+    // With an area of interest, views are found through the same grid the hit tests use, rebuilt
+    // here from the end-of-tick positions
+    bool filtered = config->view_radius > 0.0f;
+    int leader = -1;
+    if (filtered) {
+        build_grid(world.grid, world);
+        leader = find_leader(world);
+    }
+
+    size_t encoded_count = 0;
+    uint64_t queued_bytes = 0, queued_inputs = 0;
+    for (int i = 0; i < config->max_players; i++) {
+        ClientSlot& slot = slots[i];
+        if (slot.fd < 0) continue;
+        queued_inputs += slot.inputs.count;
+
+        const Snapshot* source = &current;
+        const Snapshot* baseline = history.find(slot.acked_snapshot);
+        if (filtered) {
+            // Narrow both sides of the delta to what this client saw at the time
+            InterestSet& view = slot.interest.insert(tick);
+            gather_visible(world, i, config->view_radius, leader, view.ids);
+            filter_snapshot(current, view.ids, view_current);
+            source = &view_current;
+            const InterestSet* seen = baseline ? slot.interest.find(baseline->seq) : NULL;
+            if (seen) {
+                filter_snapshot(*baseline, seen->ids, view_baseline);
+                baseline = &view_baseline;
+            } else {
+                baseline = NULL; // We never sent them that snapshot (e.g. the slot changed hands)
+            }
+            encoded_count = 0; // Nobody else shares this view, so there is nothing to reuse
+        }
+
+        EncodedSnapshot* snapshot = &encoding(*source, baseline, encoded_count);
+
+        // The records are shared, but the GameStatePacket in front of them is per client: it tells the
+        // client which of its inputs the state already includes, so its prediction can replay the rest.
+        // The kernel gathers the per-client parts and the shared records into one send.
+        GameStatePacket state;
+        wire::read(snapshot->frame.data() + FRAME_HEADER_SIZE, state);
+        state.last_input = slot.applied_seq;
+        uint8_t state_bytes[GAME_STATE_HEADER_SIZE];
+        wire::encode_at<0>(state_bytes, state);
+        size_t records_offset = FRAME_HEADER_SIZE + GAME_STATE_HEADER_SIZE;
+        size_t payload_size = snapshot->frame.size() - FRAME_HEADER_SIZE;
+        iovec parts[3];
+        parts[1].iov_base = state_bytes;
+        parts[1].iov_len = sizeof(state_bytes);
+        parts[2].iov_base = snapshot->frame.data() + records_offset;
+        parts[2].iov_len = snapshot->frame.size() - records_offset;
+        if (slot.udp_bound && payload_size <= MAX_SNAPSHOT_DATAGRAM) {
+            DatagramHeader dh;
+            dh.token = slot.udp_token;
+            dh.room = (uint16_t)number;
+            dh.id = (uint16_t)i;
+            dh.type = STATE_UPDATE;
+            dh.seq = tick;
+            dh.ack = slot.input_acks.latest;
+            dh.ack_bits = slot.input_acks.bits;
+            uint8_t dh_bytes[DATAGRAM_HEADER_SIZE];
+            wire::encode_at<0>(dh_bytes, dh);
+            parts[0].iov_base = dh_bytes;
+            parts[0].iov_len = sizeof(dh_bytes);
+            msghdr msg{};
+            msg.msg_iov = parts;
+            msg.msg_iovlen = 3;
+            msg.msg_name = &slot.udp_addr;
+            msg.msg_namelen = sizeof(slot.udp_addr);
+            ssize_t sent = sendmsg(udp_fd, &msg, 0);
+            if (sent < 0) {
+                metrics->datagrams_failed.add(1);
+            } else {
+                metrics->bytes_out.add((uint64_t)sent);
+                stats.clients[i].bytes_out.add((uint64_t)sent);
+            }
+        } else {
+            parts[0].iov_base = snapshot->frame.data(); // FrameHeader
+            parts[0].iov_len = FRAME_HEADER_SIZE;
+            size_t written = 0;
+            StreamResult result = send_stream(slot.fd, slot.tx, parts, 3, written);
+            stats.clients[i].bytes_out.add(written);
+            if (result == STREAM_STALLED) log_line("Room %d: Player %d stopped reading snapshots. Dropping them.", number, i);
+            if (result != STREAM_OK) {
+                disconnect(i);
+            } else {
+                queued_bytes += slot.tx.bytes.size() - slot.tx.sent;
+            }
+        }
+        metrics->snapshots_sent.add(1);
+    }
+
+    // Spectators see every player, so with an area of interest the per-client encodings above are no use
+    // to them; without one they share them
+    if (filtered) encoded_count = 0;
+    send_to_spectators(current, encoded_count, queued_bytes);
+    stats.outbound_queued_bytes.set(queued_bytes);
+    stats.input_queue_depth.set(queued_inputs);
+    metrics->broadcast.observe(monotonic_ns() - start);
+}
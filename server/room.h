@@ -0,0 +1,187 @@
+#ifndef ROOM_H // Include guard to prevent multiple inclusions
+#define ROOM_H
+
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <netinet/in.h> // sockaddr_in
+#include <sys/types.h>  // ssize_t
+#include <sys/uio.h>    // iovec
+#include "../common/protocol.h"
+#include "../common/stream_buffer.h"
+#include "../common/snapshot.h"
+#include "../common/ack_tracker.h"
+#include "config.h"
+#include "world.h"
+#include "interest.h"
+#include "metrics.h"
+#include "recording.h"
+
+static const size_t CLIENT_RECV_BUFFER = 1024; // Per-connection receive buffer (~40 input frames)
+static const uint32_t MAX_CLIENT_PAYLOAD = 256; // Clients only send small frames; anything bigger is a broken peer
+
+// --- Simulation tuning ---
+static const int INPUT_QUEUE_CAPACITY = 8;  // Inputs buffered per player; beyond this the oldest are dropped
+static const int INPUT_HOLD_TICKS = 4;      // Ticks we keep repeating the last input when a client's packets are late
+static const int SEND_STALL_MS = 2000;      // A client whose socket hasn't taken a byte for this long is disconnected
+static const int MAX_SPECTATORS = 64;       // Per room; more viewers should watch through a relay_app
+
+// Fixed-size FIFO of inputs waiting for their tick. A plain array ring, so queuing never allocates.
+struct InputQueue {
+    InputPacket items[INPUT_QUEUE_CAPACITY];
+    int head = 0;
+    int count = 0;
+
+    // Returns false when the oldest input had to be dropped to make room.
+    bool push(const InputPacket& input) {
+        bool dropped = false;
+        if (count == INPUT_QUEUE_CAPACITY) {
+            head = (head + 1) % INPUT_QUEUE_CAPACITY;
+            count--;
+            dropped = true;
+        }
+        items[(head + count) % INPUT_QUEUE_CAPACITY] = input;
+        count++;
+        return !dropped;
+    }
+
+    bool pop(InputPacket& out) {
+        if (count == 0) return false;
+        out = items[head];
+        head = (head + 1) % INPUT_QUEUE_CAPACITY;
+        count--;
+        return true;
+    }
+
+    void clear() { head = 0; count = 0; }
+};
+
+// Bytes the kernel wouldn't take yet. Only snapshots are ever queued, and only the newest matters: a snapshot
+// none of whose bytes have gone out is replaced by the next one instead of queued behind it. So the queue
+// holds at most the unsent tail of one frame plus one whole frame, however long the client stalls.
+struct OutboundQueue {
+    std::vector<uint8_t> bytes; // Keeps its capacity between stalls, so queuing stops allocating once warmed up
+    size_t sent = 0;            // bytes[0 .. sent) already went out
+    size_t snapshot_start = 0;  // Where the replaceable snapshot starts, if has_unsent_snapshot
+    bool has_unsent_snapshot = false;
+    uint32_t last_progress = 0; // Tick the socket last took bytes from the queue (or the queue started)
+
+    bool empty() const { return sent == bytes.size(); }
+    void clear() { bytes.clear(); sent = 0; has_unsent_snapshot = false; }
+};
+
+// Everything the server tracks per connection besides the replicated PlayerState.
+struct ClientSlot {
+    int fd = -1;            // -1 means the slot is free
+    StreamBuffer rx{0, MAX_CLIENT_PAYLOAD}; // Allocated on first join, then reused by whoever gets the slot
+    InputQueue inputs;
+    uint32_t last_seq = 0;  // Highest input sequence number accepted so far (duplicates/stale ones are dropped)
+    uint32_t applied_seq = 0; // Newest input the simulation has used; sent back for client-side reconciliation
+    bool has_input = false; // Whether last_input holds anything yet
+    InputPacket last_input; // Repeated for up to INPUT_HOLD_TICKS when the queue runs dry
+    int starved_ticks = 0;
+    uint32_t acked_snapshot = 0; // Newest snapshot the client confirmed; its delta baseline (0 = send full)
+    OutboundQueue tx;            // TCP snapshots waiting for the socket to become writable
+
+    // UDP transport: the client proves it owns udp_token from its first datagram, after which
+    // snapshots go to udp_addr instead of down the TCP stream.
+    uint32_t udp_token = 0;
+    bool udp_bound = false;
+    sockaddr_in udp_addr;
+    AckTracker input_acks; // Which of the client's input datagrams we got, echoed back in every snapshot
+
+    // Area of interest: which players went into each recent snapshot, to rebuild this client's baselines
+    InterestHistory interest;
+};
+
+// A connection that only watches: it gets every player's state, sends nothing but acks and has no
+// player id. Snapshots go out over TCP only.
+struct SpectatorSlot {
+    int fd = -1; // -1 means the slot is free
+    StreamBuffer rx{0, MAX_CLIENT_PAYLOAD};
+    uint32_t acked_snapshot = 0;
+    OutboundQueue tx;
+};
+
+// A snapshot frame encoded against one particular baseline. Clients that acked the same snapshot
+// get byte-identical deltas, so each tick encodes once per distinct baseline, not once per client.
+struct EncodedSnapshot {
+    uint32_t baseline;
+    std::vector<uint8_t> frame; // FrameHeader + STATE_UPDATE payload, ready to send
+};
+
+// One match: its own world, players, tick counter and snapshot history. A room is only ever touched by
+// the worker thread that owns it; `population` is the one field other workers read (to place joins).
+struct Room {
+    int number = 0;     // 1-based, as clients ask for it in JoinPacket
+    int worker = 0;     // Index of the owning worker thread
+    int local_index = 0; // Position in that worker's room list (part of each client socket's epoll tag)
+    const ServerConfig* config = NULL;
+    std::atomic<int> population{0};
+    WorkerMetrics* metrics = NULL; // The owning worker's
+    RoomMetrics stats;
+
+    World world;
+    std::vector<ClientSlot> slots; // Slot index == player id
+    std::vector<uint16_t> free_slots; // Stack of free ids, so joining is O(1)
+    std::vector<SpectatorSlot> spectators;
+    std::vector<uint16_t> free_spectators;
+    std::vector<PlayerCommand> commands;
+    uint32_t tick = 0;
+    uint32_t max_rewind_ticks = 0; // --max-rewind-ms in ticks (the position history holds this many)
+    uint32_t max_stall_ticks = 0;  // SEND_STALL_MS in ticks
+    bool restart_requested = false; // Applied at the start of the next tick, not mid-packet
+    Recorder recorder; // --record: this room's joins, leaves and applied commands
+
+    // Snapshot history (delta baselines, indexed by tick) and this tick's encodings, reused every tick
+    SnapshotRing history;
+    std::vector<EncodedSnapshot> encoded;
+    // Area of interest scratch: one client's view of the current snapshot and of its baseline
+    Snapshot view_current;
+    Snapshot view_baseline;
+
+    void init(int number, const ServerConfig& config);
+
+    // Give a connection a player slot and send its WelcomePacket. Returns the player id, or -1 if full.
+    int admit(int fd, uint32_t udp_token, uint16_t udp_port);
+    void disconnect(int id);
+    // Same for a spectator: returns its spectator index, or -1 if the room has no spectator places left.
+    int admit_spectator(int fd);
+    void drop_spectator(int k);
+
+    // Drain a client's TCP stream (edge-triggered: until EAGAIN) and queue its inputs.
+    void on_readable(int id);
+    // An input datagram whose header names this room.
+    void on_datagram(const DatagramHeader& header, const uint8_t* body, size_t length, const sockaddr_in& from);
+    // The client's socket has room again: flush its queued snapshot bytes (edge-triggered: until empty or EAGAIN).
+    void on_writable(int id);
+    void on_spectator_readable(int k);
+    void on_spectator_writable(int k);
+
+    void run_tick(float dt);
+    void broadcast(int udp_fd);
+
+private:
+    enum StreamResult {
+        STREAM_OK,      // Sent, or queued for EPOLLOUT
+        STREAM_CLOSED,  // Socket error: drop the connection
+        STREAM_STALLED  // Backed up and no bytes taken for SEND_STALL_MS: drop the connection
+    };
+    // Send a snapshot frame (gathered from `parts`) down a TCP stream without ever blocking. `written` gets
+    // the bytes the kernel took.
+    StreamResult send_stream(int fd, OutboundQueue& out, const iovec* parts, int count, size_t& written);
+    // Send a control frame (the welcome) the same way. It is never superseded by the next snapshot: a
+    // short write leaves the rest queued ahead of everything after it.
+    template <class Packet>
+    StreamResult send_control(int fd, OutboundQueue& out, PacketType type, const Packet& packet, size_t& written);
+    // Push queued bytes into a socket that has room again (edge-triggered: until empty or EAGAIN).
+    StreamResult flush_stream(int fd, OutboundQueue& out, size_t& written);
+    // A slow reader keeps its connection as long as the queue moves; one that took nothing for
+    // SEND_STALL_MS is counted and dropped.
+    bool stalled(const OutboundQueue& out);
+    // The encoding of `source` against `baseline`, from this tick's cache or freshly made.
+    EncodedSnapshot& encoding(const Snapshot& source, const Snapshot* baseline, size_t& encoded_count);
+    void send_to_spectators(const Snapshot& current, size_t& encoded_count, uint64_t& queued_bytes);
+};
+
+#endif // ROOM_H
@@ -0,0 +1,386 @@
+#include "worker.h"
+#include "log.h"
+#include "../common/clock.h"
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h> // close(), read(), write()
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h> // for TCP_NODELAY
+#include <sys/epoll.h> // Linux event notification (scales with active sockets, not total sockets)
+#include <sys/timerfd.h> // Monotonic tick clock that plugs straight into epoll
+#include <sys/eventfd.h> // Cross-thread wakeup for handed-over connections
+
+// epoll_event.data tags. Client sockets store (room local_index << 16) | player id, so an event maps
+// straight to its room and player without searching; spectators set SPECTATOR_FLAG in the room half and
+// carry their spectator index instead; pending connections use room PENDING_ROOM.
+// The fixed tags below all have 0xFFFF in the room half, which no real room can have.
+static const uint32_t LISTENER_TAG = 0xFFFFFFFFu;
+static const uint32_t TIMER_TAG = 0xFFFFFFFEu;
+static const uint32_t UDP_TAG = 0xFFFFFFFDu;
+static const uint32_t WAKE_TAG = 0xFFFFFFFCu;
+static const uint32_t PENDING_ROOM = 0xFFFEu;
+static const uint32_t SPECTATOR_FLAG = 0x8000u; // Room local indexes stay far below this (MAX_ROOMS)
+static const int MAX_EVENTS = 256; // How many ready sockets we pull out of the kernel per epoll_wait()
+static const size_t PENDING_RECV_BUFFER = 64; // A JoinPacket frame is 8 bytes
+static const size_t MAX_INPUT_DATAGRAM = 512;  // Room for newer clients' longer InputPackets too
+static const int CLIENT_SEND_BUFFER = 64 * 1024; // Kernel send buffer per client socket (SO_SNDBUF)
+
+bool Worker::open() {
+    // Edge-triggered (EPOLLET): the kernel only tells us when a socket goes from "nothing to read" to
+    // "something to read", so every handler must keep reading until it gets EAGAIN.
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        return false;
+    }
+
+    // 1. Listening socket (non-blocking, so we can drain accept() until it runs dry). Every worker binds
+    // the same port with SO_REUSEPORT and the kernel balances incoming connections across them.
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Failed to create socket\n";
+        return false;
+    }
+    int opt = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    setsockopt(listen_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    sockaddr_in server_addr{}; // curly braces zero-initialize the struct
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    server_addr.sin_port = htons(SERVER_PORT);
+    if (bind(listen_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        std::cerr << "Bind failed\n";
+        return false;
+    }
+    // The backlog is the kernel's queue of finished handshakes we haven't accept()ed yet, so a burst of
+    // joins needs a deep one (the kernel caps it at somaxconn).
+    listen(listen_fd, SOMAXCONN);
+    epoll_event listen_event{};
+    listen_event.events = EPOLLIN | EPOLLET;
+    listen_event.data.u32 = LISTENER_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_event);
+
+    // 2. Tick clock: a periodic CLOCK_MONOTONIC timerfd. Reading it returns how many periods have elapsed,
+    // which is exactly how many ticks we owe if a slow iteration made us miss some.
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        perror("timerfd_create");
+        return false;
+    }
+    long tick_ns = 1000000000L / config->tick_rate;
+    itimerspec tick_spec{};
+    tick_spec.it_interval.tv_sec = tick_ns / 1000000000L;
+    tick_spec.it_interval.tv_nsec = tick_ns % 1000000000L;
+    tick_spec.it_value = tick_spec.it_interval;
+    timerfd_settime(timer_fd, 0, &tick_spec, NULL);
+    epoll_event timer_event{};
+    timer_event.events = EPOLLIN; // Level-triggered: fires until the expiration count is read
+    timer_event.data.u32 = TIMER_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &timer_event);
+
+    // 3. Optional UDP socket. One socket serves every player of this worker's rooms; the room, id and
+    // token in each datagram tell us who sent it.
+    if (config->udp) {
+        udp_port = (uint16_t)(SERVER_PORT + index);
+        server_addr.sin_port = htons(udp_port);
+        udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (udp_fd < 0 || bind(udp_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+            std::cerr << "UDP bind failed on port " << udp_port << "\n";
+            return false;
+        }
+        int buffer_size = 4 * 1024 * 1024; // Inputs from thousands of players can land between two wakeups
+        setsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+        epoll_event udp_event{};
+        udp_event.events = EPOLLIN | EPOLLET;
+        udp_event.data.u32 = UDP_TAG;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, udp_fd, &udp_event);
+    }
+
+    // 4. Handoff doorbell
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        perror("eventfd");
+        return false;
+    }
+    epoll_event wake_event{};
+    wake_event.events = EPOLLIN | EPOLLET;
+    wake_event.data.u32 = WAKE_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake_event);
+
+    pending.resize(MAX_PENDING);
+    free_pending.reserve(MAX_PENDING);
+    for (int p = MAX_PENDING - 1; p >= 0; p--) free_pending.push_back((uint16_t)p);
+    token_rng.seed(std::random_device{}());
+    return true;
+}
+
+void Worker::hand_over(int fd, int room, bool spectator) {
+    {
+        std::lock_guard<std::mutex> guard(handoff_lock);
+        Handoff handoff;
+        handoff.fd = fd;
+        handoff.room = room;
+        handoff.spectator = spectator;
+        handoffs.push_back(handoff);
+    }
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) log_line("eventfd write: %s", strerror(errno));
+}
+
+void Worker::take_handoffs() {
+    uint64_t count;
+    if (read(wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) log_line("eventfd read: %s", strerror(errno));
+    std::vector<Handoff> arrived;
+    {
+        std::lock_guard<std::mutex> guard(handoff_lock);
+        arrived.swap(handoffs);
+    }
+    for (size_t k = 0; k < arrived.size(); k++) admit(arrived[k].fd, arrived[k].room, arrived[k].spectator);
+}
+
+// Accept until the backlog is empty. New connections wait in the pending table for their JoinPacket.
+void Worker::accept_connections() {
+    while (true) {
+        sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int new_socket = accept4(listen_fd, (struct sockaddr*)&client_addr, &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (new_socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) log_line("accept4: %s", strerror(errno));
+            break; // Backlog drained (or out of descriptors - try again on the next wakeup)
+        }
+
+        if (free_pending.empty()) {
+            log_line("Too many connections are still joining. Connection refused.");
+            close(new_socket);
+            continue;
+        }
+
+        // Apply TCP_NODELAY to the new client too
+        int opt = 1;
+        setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        // Keep the kernel's send buffer small. Otherwise it autotunes up to megabytes, and a client that
+        // stops reading would have seconds of stale snapshots queued there before our own queue notices.
+        int send_buffer = CLIENT_SEND_BUFFER;
+        setsockopt(new_socket, SOL_SOCKET, SO_SNDBUF, &send_buffer, sizeof(send_buffer));
+
+        uint16_t p = free_pending.back();
+        free_pending.pop_back();
+        PendingConnection& connection = pending[p];
+        connection.fd = new_socket;
+        if (connection.rx.data.empty()) connection.rx.data.resize(PENDING_RECV_BUFFER);
+        connection.rx.clear();
+
+        epoll_event client_event{};
+        client_event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        client_event.data.u32 = (PENDING_ROOM << 16) | p;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, new_socket, &client_event);
+    }
+}
+
+void Worker::close_pending(int p) {
+    close(pending[p].fd);
+    pending[p].fd = -1;
+    free_pending.push_back((uint16_t)p);
+}
+
+void Worker::read_pending(int p) {
+    PendingConnection& connection = pending[p];
+    while (connection.fd >= 0) {
+        ssize_t valread = connection.rx.recv_from(connection.fd);
+        if (valread < 0 && errno == EINTR) continue;
+        if (valread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (valread <= 0) {
+            close_pending(p); // Gave up before joining
+            break;
+        }
+
+        FrameHeader header;
+        const uint8_t* payload = NULL;
+        StreamBuffer::Result result = connection.rx.next_frame(header, payload);
+        if (result == StreamBuffer::NEED_MORE) continue;
+        JoinPacket join;
+        if (result == StreamBuffer::FRAME && (header.type == JOIN || header.type == SPECTATE) &&
+            wire::decode(payload, header.length, join)) {
+            int fd = connection.fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL); // It gets a new tag (and maybe a new worker)
+            connection.fd = -1;
+            free_pending.push_back((uint16_t)p);
+            place(fd, join.room, header.type == SPECTATE);
+            break;
+        }
+        // Clients from before the versioned protocol send a JoinPacket without a version, too short to decode
+        log_line("A connection sent something other than a JoinPacket (or an outdated one). Dropping it.");
+        close_pending(p);
+    }
+}
+
+// Pick the room for a join: the one asked for, or the least crowded one that still has space.
+// A spectator without a preference watches the busiest room instead.
+void Worker::place(int fd, uint16_t requested_room, bool spectator) {
+    std::vector<Room>& rooms_list = *all_rooms;
+    int room = -1;
+    if (requested_room == ANY_ROOM && spectator) {
+        int highest = -1;
+        for (size_t r = 0; r < rooms_list.size(); r++) {
+            int population = rooms_list[r].population.load(std::memory_order_relaxed);
+            if (population > highest) {
+                highest = population;
+                room = (int)r;
+            }
+        }
+    } else if (requested_room == ANY_ROOM) {
+        int lowest = config->max_players;
+        for (size_t r = 0; r < rooms_list.size(); r++) {
+            int population = rooms_list[r].population.load(std::memory_order_relaxed);
+            if (population < lowest) {
+                lowest = population;
+                room = (int)r;
+            }
+        }
+    } else if (requested_room <= rooms_list.size()) {
+        room = requested_room - 1;
+    }
+    if (room < 0) {
+        log_line("A player asked for room %u, which is full or doesn't exist. Connection refused.", requested_room);
+        close(fd);
+        return;
+    }
+
+    Worker& owner = (*all_workers)[rooms_list[room].worker];
+    if (&owner == this) {
+        admit(fd, room, spectator);
+    } else {
+        owner.hand_over(fd, room, spectator);
+    }
+}
+
+// On the room's own worker: take a player (or spectator) slot and start listening to the socket.
+void Worker::admit(int fd, int room_index, bool spectator) {
+    Room& room = (*all_rooms)[room_index];
+    if (spectator) {
+        int k = room.admit_spectator(fd);
+        if (k < 0) {
+            log_line("Room %d has no spectator places left. Connection refused.", room.number);
+            close(fd);
+            return;
+        }
+        epoll_event spectator_event{};
+        spectator_event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        spectator_event.data.u32 = (((uint32_t)room.local_index | SPECTATOR_FLAG) << 16) | (uint32_t)k;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &spectator_event);
+        return;
+    }
+
+    uint32_t udp_token = 0;
+    while (config->udp && udp_token == 0) udp_token = token_rng();
+
+    int id = room.admit(fd, udp_token, udp_port);
+    if (id < 0) {
+        log_line("A player tried to join room %d but it is full. Connection refused.", room.number);
+        close(fd);
+        return;
+    }
+
+    // EPOLLOUT too: edge-triggered, it only fires when a socket we filled up has room again
+    epoll_event client_event{};
+    client_event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    client_event.data.u32 = ((uint32_t)room.local_index << 16) | (uint32_t)id;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &client_event);
+}
+
+// Drain the UDP socket; every datagram is self-contained.
+void Worker::receive_datagrams() {
+    uint8_t datagram[MAX_INPUT_DATAGRAM];
+    while (true) {
+        sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(udp_fd, datagram, sizeof(datagram), 0, (struct sockaddr*)&from, &from_len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break; // EAGAIN: drained
+        }
+        DatagramHeader dh;
+        if (n < (ssize_t)(DATAGRAM_HEADER_SIZE + 1)) {
+            metrics.datagrams_rejected.add(1);
+            continue;
+        }
+        wire::read(datagram, dh);
+        if (dh.room == 0 || dh.room > all_rooms->size() ||
+            (*all_rooms)[dh.room - 1].worker != index) { // Rooms only take datagrams on their own worker's port
+            metrics.datagrams_rejected.add(1);
+            continue;
+        }
+        Room& room = (*all_rooms)[dh.room - 1];
+        room.on_datagram(dh, datagram + DATAGRAM_HEADER_SIZE, (size_t)n - DATAGRAM_HEADER_SIZE, from);
+    }
+}
+
+void Worker::run() {
+    std::vector<epoll_event> events(MAX_EVENTS);
+    const float dt = 1.0f / config->tick_rate;
+
+    while (true) {
+        // Wait for activity on ANY socket or the tick timer
+        int ready = epoll_wait(epoll_fd, events.data(), MAX_EVENTS, -1);
+        if (ready < 0) { // handle signal interrupts(EINTR)
+            if (errno == EINTR) {
+                continue; // Just a system interrupt, continue
+            } else {
+                log_line("epoll_wait error: %s", strerror(errno)); // A real problem
+                continue;
+            }
+        }
+
+        uint64_t ticks_due = 0;
+        for (int e = 0; e < ready; e++) {
+            uint32_t tag = events[e].data.u32;
+
+            if (tag == TIMER_TAG) {
+                uint64_t expirations = 0;
+                if (read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) ticks_due += expirations;
+            } else if (tag == UDP_TAG) {
+                receive_datagrams();
+            } else if (tag == LISTENER_TAG) {
+                accept_connections();
+            } else if (tag == WAKE_TAG) {
+                take_handoffs();
+            } else if ((tag >> 16) == PENDING_ROOM) {
+                read_pending(tag & 0xFFFF);
+            } else if ((tag >> 16) & SPECTATOR_FLAG) {
+                Room& room = *rooms[(tag >> 16) & ~SPECTATOR_FLAG];
+                int k = tag & 0xFFFF;
+                if ((events[e].events & EPOLLOUT) && room.spectators[k].fd >= 0) room.on_spectator_writable(k);
+                if ((events[e].events & ~EPOLLOUT) && room.spectators[k].fd >= 0) room.on_spectator_readable(k);
+            } else {
+                // A player's socket. The slot may have been freed earlier in this batch (or by the flush).
+                Room& room = *rooms[tag >> 16];
+                int id = tag & 0xFFFF;
+                if ((events[e].events & EPOLLOUT) && room.slots[id].fd >= 0) room.on_writable(id);
+                if ((events[e].events & ~EPOLLOUT) && room.slots[id].fd >= 0) room.on_readable(id);
+            }
+        }
+
+        if (ticks_due == 0) continue;
+
+        // Run the simulation on the clock. If we fell behind (a long stall), catch up with a bounded
+        // number of back-to-back ticks and skip the rest rather than spiralling.
+        if (ticks_due > (uint64_t)MAX_CATCHUP_TICKS) {
+            log_line("Worker %d fell behind by %llu ticks, skipping %llu", index, (unsigned long long)ticks_due,
+                     (unsigned long long)(ticks_due - MAX_CATCHUP_TICKS));
+            metrics.ticks_skipped.add(ticks_due - MAX_CATCHUP_TICKS);
+            ticks_due = MAX_CATCHUP_TICKS;
+        }
+        uint64_t tick_start = monotonic_ns();
+        for (size_t r = 0; r < rooms.size(); r++) {
+            if (rooms[r]->population.load(std::memory_order_relaxed) == 0) continue; // Empty rooms stand still
+            for (uint64_t t = 0; t < ticks_due; t++) rooms[r]->run_tick(dt);
+            rooms[r]->broadcast(udp_fd);
+        }
+        metrics.tick.observe(monotonic_ns() - tick_start);
+    }
+}
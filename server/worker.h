@@ -0,0 +1,79 @@
+#ifndef WORKER_H // Include guard to prevent multiple inclusions
+#define WORKER_H
+
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <random>
+#include "../common/stream_buffer.h"
+#include "config.h"
+#include "room.h"
+#include "metrics.h"
+
+// --- Worker threads ---
+//
+// Each worker is one thread, pinned to one core, running its own epoll loop over its own sockets:
+//   - a TCP listener on SERVER_PORT with SO_REUSEPORT, so the kernel spreads new connections over workers
+//   - a tick timerfd driving every room it owns
+//   - with --udp, a UDP socket on SERVER_PORT + worker index
+//   - an eventfd other workers ring when they hand it a connection
+// A connection stays "pending" on the worker that accepted it until its JoinPacket says which room it
+// wants. If that room lives on another worker, the socket is passed over through that worker's handoff
+// queue - the only state workers share besides each room's population counter.
+
+static const int MAX_CATCHUP_TICKS = 5; // Ticks simulated back-to-back after a stall before we give up and skip
+static const int MAX_PENDING = 4096;    // Accepted connections per worker still waiting to send their JoinPacket
+
+// A connection that hasn't said which room it wants yet.
+struct PendingConnection {
+    int fd = -1; // -1 = free
+    StreamBuffer rx{0, 32}; // A JoinPacket is 3 bytes; newer clients may append fields
+};
+
+// A joined connection on its way to the worker that owns its room.
+struct Handoff {
+    int fd;
+    int room; // Index into the global room list
+    bool spectator;
+};
+
+struct Worker {
+    int index = 0;
+    const ServerConfig* config = NULL;
+    std::vector<Room>* all_rooms = NULL;     // Every room in the process (placement reads their population)
+    std::vector<Worker>* all_workers = NULL; // To hand connections to their room's owner
+    std::vector<Room*> rooms;                // The rooms this worker runs; a room's position is its local_index
+
+    int epoll_fd = -1;
+    int listen_fd = -1;
+    int timer_fd = -1;
+    int udp_fd = -1;
+    int wake_fd = -1; // eventfd: handoffs are waiting
+    uint16_t udp_port = 0;
+    WorkerMetrics metrics; // Written only by this worker's thread; read by the metrics endpoint
+
+    std::vector<PendingConnection> pending;
+    std::vector<uint16_t> free_pending;
+    std::mt19937 token_rng;
+
+    std::mutex handoff_lock; // Guards handoffs; taken by the sending worker and by us
+    std::vector<Handoff> handoffs;
+
+    // Create this worker's sockets. Runs on the main thread, so a port clash stops the server at startup.
+    bool open();
+    void run(); // The event loop; never returns
+
+    // Called from another worker's thread: queue a connection for one of our rooms.
+    void hand_over(int fd, int room, bool spectator);
+
+private:
+    void accept_connections();
+    void read_pending(int p);
+    void close_pending(int p);
+    void place(int fd, uint16_t requested_room, bool spectator);
+    void admit(int fd, int room, bool spectator);
+    void receive_datagrams();
+    void take_handoffs();
+};
+
+#endif // WORKER_H
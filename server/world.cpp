@@ -0,0 +1,203 @@
+#include "world.h"
+#include "hit_kernel.h"
+#include <cmath>
+#include <algorithm>
+
+void SpatialGrid::init(int capacity) {
+    cols = (int)std::ceil(MAP_WIDTH / GRID_CELL_SIZE);
+    rows = (int)std::ceil(MAP_HEIGHT / GRID_CELL_SIZE);
+    cell_start.assign(cols * rows + 1, 0);
+    entries.assign(capacity, 0);
+    xs.assign(capacity, 0.0f);
+    ys.assign(capacity, 0.0f);
+    cell_of.assign(capacity, 0);
+}
+
+int SpatialGrid::cell_x(float x) const {
+    int c = (int)(x / GRID_CELL_SIZE);
+    return c < 0 ? 0 : (c >= cols ? cols - 1 : c);
+}
+
+int SpatialGrid::cell_y(float y) const {
+    int c = (int)(y / GRID_CELL_SIZE);
+    return c < 0 ? 0 : (c >= rows ? rows - 1 : c);
+}
+
+// Counting sort of active players into cells: count per cell, prefix-sum into start offsets, then scatter.
+void build_grid(SpatialGrid& grid, const World& world) {
+    std::fill(grid.cell_start.begin(), grid.cell_start.end(), 0);
+    for (int i = 0; i < world.capacity; i++) {
+        if (!world.active[i]) continue;
+        uint32_t c = grid.cell_y(world.y[i]) * grid.cols + grid.cell_x(world.x[i]);
+        grid.cell_of[i] = c;
+        grid.cell_start[c + 1]++;
+    }
+    for (size_t c = 1; c < grid.cell_start.size(); c++) grid.cell_start[c] += grid.cell_start[c - 1];
+
+    // Scatter using cell_start[c] as a cursor, then shift back so cell_start[c] is the start again
+    for (int i = 0; i < world.capacity; i++) {
+        if (!world.active[i]) continue;
+        uint32_t k = grid.cell_start[grid.cell_of[i]]++;
+        grid.entries[k] = (uint16_t)i;
+        grid.xs[k] = world.x[i];
+        grid.ys[k] = world.y[i];
+    }
+    for (size_t c = grid.cell_start.size() - 1; c > 0; c--) grid.cell_start[c] = grid.cell_start[c - 1];
+    grid.cell_start[0] = 0;
+}
+
+void PositionHistory::init(int frame_count, int capacity) {
+    ticks.assign(frame_count, 0);
+    frames.resize(frame_count);
+    for (int f = 0; f < frame_count; f++) frames[f].init(capacity);
+}
+
+void PositionHistory::clear() {
+    std::fill(ticks.begin(), ticks.end(), 0);
+}
+
+const SpatialGrid* PositionHistory::find(uint32_t tick) const {
+    if (tick == 0 || ticks.empty()) return NULL;
+    size_t f = tick % ticks.size();
+    return ticks[f] == tick ? &frames[f] : NULL;
+}
+
+void PositionHistory::record(uint32_t tick, const World& world) {
+    if (ticks.empty()) return;
+    size_t f = tick % ticks.size();
+    build_grid(frames[f], world);
+    ticks[f] = tick;
+}
+
+void World::init(int max_players, int history_frames) {
+    capacity = max_players;
+    active.assign(capacity, 0);
+    x.assign(capacity, 0.0f);
+    y.assign(capacity, 0.0f);
+    rotation.assign(capacity, 0.0f);
+    score.assign(capacity, 0);
+    attacking.assign(capacity, 0);
+    prev_rotation.assign(capacity, 0.0f);
+    prev_attacking.assign(capacity, 0);
+
+    grid.init(capacity);
+    attackers.reserve(capacity);
+    hit_index.assign(capacity, 0);
+    score_delta.assign(capacity, 0);
+    push_x.assign(capacity, 0.0f);
+    push_y.assign(capacity, 0.0f);
+    history.init(history_frames, capacity);
+}
+
+void World::spawn(int id) {
+    active[id] = 1;
+    x[id] = 700.0f; // Default start X
+    y[id] = 450.0f; // Default start Y
+    rotation[id] = 0.0f;
+    score[id] = 0;
+    attacking[id] = 0;
+    prev_rotation[id] = 0.0f;
+    prev_attacking[id] = 0;
+}
+
+void World::despawn(int id) {
+    active[id] = 0;
+    attacking[id] = 0;
+}
+
+void World::reset_round() {
+    for (int i = 0; i < capacity; i++) {
+        score[i] = 0;
+        x[i] = 700.0f; // Reset to center
+        y[i] = 450.0f;
+    }
+    history.clear(); // Nobody should be hit where they stood before the restart
+}
+
+PlayerState World::player_state(int id) const {
+    PlayerState p;
+    p.id = (uint16_t)id;
+    p.active = active[id];
+    p.x = x[id];
+    p.y = y[id];
+    p.rotation = rotation[id];
+    p.score = score[id];
+    p.is_attacking = attacking[id];
+    return p;
+}
+
+void simulate_tick(World& world, const std::vector<PlayerCommand>& commands, float dt) {
+    move_players(world, commands, dt);
+    resolve_attacks(world, commands);
+}
+
+// 1. Movement + arena boundary clamping
+void move_players(World& world, const std::vector<PlayerCommand>& commands, float dt) {
+    world.attackers.clear();
+    for (int i = 0; i < world.capacity; i++) {
+        if (!world.active[i]) continue;
+        const PlayerCommand& cmd = commands[i];
+        world.prev_rotation[i] = world.rotation[i];
+        world.prev_attacking[i] = world.attacking[i];
+        if (!cmd.present) {
+            world.attacking[i] = 0;
+            continue;
+        }
+        move_player(world.x[i], world.y[i], cmd.dx, cmd.dy, dt);
+
+        world.rotation[i] = cmd.rotation;
+        world.attacking[i] = cmd.attack;
+        if (cmd.attack) world.attackers.push_back((uint16_t)i);
+    }
+}
+
+// 2. Collision Detection (Only for players who are attacking), against nearby grid cells only
+void resolve_attacks(World& world, const std::vector<PlayerCommand>& commands) {
+    if (world.attackers.empty()) return;
+    build_grid(world.grid, world);
+    for (size_t a = 0; a < world.attackers.size(); a++) {
+        int i = world.attackers[a];
+        float dir_x = std::cos(world.rotation[i]);
+        float dir_y = std::sin(world.rotation[i]);
+        float paper_length = PAPER_BASE_LENGTH + (world.score[i] * PAPER_GROWTH);
+        SweptCapsule paper = make_swept_capsule(world.x[i], world.y[i], world.prev_rotation[i], world.rotation[i],
+                                                world.prev_attacking[i] != 0, PAPER_OFFSET, PAPER_OFFSET + paper_length, HIT_RADIUS);
+
+        // Lag compensation: test against where the attacker saw everyone, if we still have that tick.
+        // The attacker itself stays where it is now (its own client predicted it there).
+        const SpatialGrid* grid = &world.grid;
+        const SpatialGrid* past = world.history.find(commands[i].rewind_tick);
+        if (past) grid = past;
+
+        // Every grid row the swing's bounding box touches is one contiguous span of cell-sorted positions,
+        // which the kernel tests in place
+        float min_x, min_y, max_x, max_y;
+        swept_capsule_bounds(paper, min_x, min_y, max_x, max_y);
+        grid->query_spans(min_x, min_y, max_x, max_y, [&](uint32_t begin, uint32_t end) {
+            int hits = capsule_hits(paper, &grid->xs[begin], &grid->ys[begin], (int)(end - begin), world.hit_index.data());
+            for (int h = 0; h < hits; h++) {
+                int j = grid->entries[begin + world.hit_index[h]];
+                if (j == i || !world.active[j]) continue; // The past can hold players who have since left
+                // SUCCESSFUL SMACK!
+                world.score_delta[i]++;
+                world.score_delta[j]--;
+                // Simple knockback: Push the victim away
+                world.push_x[j] += dir_x * KNOCKBACK;
+                world.push_y[j] += dir_y * KNOCKBACK;
+            }
+        });
+    }
+
+    // 3. Apply the tick's hits all at once. Only players touched above have non-zero deltas.
+    for (int i = 0; i < world.capacity; i++) {
+        if (world.score_delta[i] == 0 && world.push_x[i] == 0.0f && world.push_y[i] == 0.0f) continue;
+        int64_t new_score = (int64_t)world.score[i] + world.score_delta[i];
+        world.score[i] = new_score > 0 ? (uint32_t)new_score : 0; // Victims never drop below 0
+        world.x[i] += world.push_x[i];
+        world.y[i] += world.push_y[i];
+        clamp_to_arena(world.x[i], world.y[i]); // A smack can't push anyone through the wall
+        world.score_delta[i] = 0;
+        world.push_x[i] = 0.0f;
+        world.push_y[i] = 0.0f;
+    }
+}
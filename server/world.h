@@ -0,0 +1,137 @@
+#ifndef WORLD_H // Include guard to prevent multiple inclusions
+#define WORLD_H
+
+#include <stdint.h>
+#include <vector>
+#include "../common/protocol.h"
+#include "../common/movement.h" // Arena size and movement, shared with client-side prediction
+
+// --- Simulation core (libsmack_sim) ---
+//
+// This header, world.cpp and hit_kernel.cpp are the whole game simulation: no sockets, clocks or threads
+// (callers that want timings wrap the calls). The server, replay_app and sim_bench link the same library,
+// so what the benchmarks measure and what the replay verifies is exactly what the server runs.
+
+// --- Combat rules ---
+static const float HIT_RADIUS = 50.0f;      // Victim hitbox radius around the newspaper
+static const float KNOCKBACK = 20.0f;       // How far a smack pushes the victim
+static const float PAPER_OFFSET = 10.0f;    // Gap between the player's centre and the newspaper's handle
+static const float PAPER_BASE_LENGTH = 50.0f; // Newspaper length at 0 points...
+static const float PAPER_GROWTH = 6.0f;       // ...plus this much per point (matches what the client draws)
+static const float GRID_CELL_SIZE = 100.0f; // Spatial grid cell edge; a 0-point swing (reach 110px) covers ~3x3 cells
+
+// What one player does this tick. The network layer picks it from the player's input queue.
+struct PlayerCommand {
+    uint8_t present; // 0 = no input this tick (player stands still, not attacking)
+    float dx;
+    float dy;
+    float rotation;
+    uint8_t attack;
+    uint32_t rewind_tick; // Test the attack against positions at the end of this tick (0 = the present)
+};
+
+// Uniform grid over the arena, rebuilt every tick with a counting sort into flat arrays
+// (no per-cell vectors, no allocation once warmed up). Positions outside the arena clamp to edge cells.
+struct SpatialGrid {
+    int cols = 0;
+    int rows = 0;
+    std::vector<uint32_t> cell_start; // Players of cell c are entries[cell_start[c] .. cell_start[c+1])
+    std::vector<uint16_t> entries;    // Player ids grouped by cell
+    std::vector<float> xs;            // Positions in the same order as entries, so a run of cells is a
+    std::vector<float> ys;            // contiguous block the hit kernel can read directly
+    std::vector<uint32_t> cell_of;    // Scratch: each player's cell for the current build
+
+    void init(int capacity);
+    int cell_x(float x) const;
+    int cell_y(float y) const;
+
+    // Calls visit(id) for every player in a cell overlapping the square around (x, y). Callers still
+    // do the exact distance test; this just narrows the candidates to the neighbourhood.
+    template <typename Visit>
+    void query(float x, float y, float radius, Visit visit) const {
+        int x0 = cell_x(x - radius), x1 = cell_x(x + radius);
+        int y0 = cell_y(y - radius), y1 = cell_y(y + radius);
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                int c = cy * cols + cx;
+                for (uint32_t k = cell_start[c]; k < cell_start[c + 1]; k++) visit(entries[k]);
+            }
+        }
+    }
+
+    // Same area as a box, but hands out one [begin, end) range of entries/xs/ys per grid row: cells in
+    // a row are adjacent in the sorted arrays, so a box is at most `rows` contiguous spans.
+    template <typename VisitSpan>
+    void query_spans(float min_x, float min_y, float max_x, float max_y, VisitSpan visit) const {
+        int x0 = cell_x(min_x), x1 = cell_x(max_x);
+        int y0 = cell_y(min_y), y1 = cell_y(max_y);
+        for (int cy = y0; cy <= y1; cy++) {
+            uint32_t begin = cell_start[cy * cols + x0];
+            uint32_t end = cell_start[cy * cols + x1 + 1];
+            if (begin < end) visit(begin, end);
+        }
+    }
+};
+
+struct World;
+
+// --- Lag compensation ---
+// Where everyone stood at the end of each recent tick, kept as cell-sorted grids so a rewound hit test
+// queries the past exactly like the present. A fixed ring of frames allocated in init(), so recording
+// a tick only copies positions into memory that already exists.
+struct PositionHistory {
+    std::vector<uint32_t> ticks;     // Tick each frame holds (0 = empty)
+    std::vector<SpatialGrid> frames; // frames[tick % size]
+
+    void init(int frame_count, int capacity);
+    void clear();
+    const SpatialGrid* find(uint32_t tick) const;
+    void record(uint32_t tick, const World& world);
+};
+
+// Authoritative player state in structure-of-arrays form: the hot loops (movement, grid build, hit tests)
+// each stream through just the arrays they need. Index == player id. PlayerState is only the wire/view form.
+struct World {
+    int capacity = 0;
+    std::vector<uint8_t> active;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> rotation;
+    std::vector<uint32_t> score;
+    std::vector<uint8_t> attacking;
+    std::vector<float> prev_rotation;    // Rotation at the end of the previous tick: where this tick's swing starts
+    std::vector<uint8_t> prev_attacking; // Whether the newspaper was already out last tick (else no sweep)
+
+    // Per-tick scratch, sized once in init()
+    SpatialGrid grid;
+    std::vector<uint16_t> attackers;
+    std::vector<uint16_t> hit_index;  // Hit kernel output
+    std::vector<int32_t> score_delta;
+    std::vector<float> push_x;
+    std::vector<float> push_y;
+
+    PositionHistory history; // Empty when lag compensation is off
+
+    void init(int max_players, int history_frames);
+    void spawn(int id);
+    void despawn(int id);
+    void reset_round(); // Restart: everyone back to the centre with 0 points (and forget their past positions)
+    PlayerState player_state(int id) const;
+};
+
+// Advance the world by one fixed step of dt seconds. commands[id] is player id's command.
+// Movement happens first; then every attack is tested against the positions at that point, and
+// scores/knockback are applied together, so the result doesn't depend on player order.
+// An attack hits along the whole newspaper and across the swing since the previous tick (hit_kernel.h).
+// With a rewind_tick the victims are taken from world.history instead, where the attacker saw them.
+void simulate_tick(World& world, const std::vector<PlayerCommand>& commands, float dt);
+
+// simulate_tick() is these two in a row; callers that time the hit tests on their own call them directly.
+void move_players(World& world, const std::vector<PlayerCommand>& commands, float dt);
+void resolve_attacks(World& world, const std::vector<PlayerCommand>& commands); // Grid build to knockback
+
+// Sort the active players into the grid by their current positions. simulate_tick() does this itself when
+// someone attacks (before knockback); call it again for queries against the end-of-tick positions.
+void build_grid(SpatialGrid& grid, const World& world);
+
+#endif // WORLD_H